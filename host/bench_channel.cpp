@@ -0,0 +1,142 @@
+/// Channel microbenchmarks
+///
+/// Compares Channel against the ring buffer plus handle queue pairs it
+/// replaced. Both run on the host FreeRTOS shim, so absolute numbers say little
+/// about the ESP32. The ratio of synchronization operations per item is what
+/// carries over.
+///
+/// stream     producer pushes items as fast as the consumer drains them
+/// ping-pong  an item goes back and forth between two tasks (interactive)
+///
+/// \file   bench_channel.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/ringbuf.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "channel.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t capacity{4u};
+constexpr size_t max_item{1024u};
+constexpr size_t ringbuf_header_size{8u};
+
+using channel_t = Channel<capacity, max_item>;
+
+/// Ring buffer plus queue carrying its handle, the way queue.hpp used to be
+struct Pair {
+  Pair()
+    : buf{xRingbufferCreate(
+        capacity * (ringbuf_header_size + sizeof(uint32_t) + max_item),
+        RINGBUF_TYPE_NOSPLIT)},
+      queue{xQueueCreate(8, sizeof(RingbufHandle_t))} {}
+
+  bool send(void const* data, size_t len) {
+    void* item;
+    if (!xRingbufferSendAcquire(buf, &item, len, portMAX_DELAY)) return false;
+    std::memcpy(item, data, len);
+    xRingbufferSendComplete(buf, item);
+    return xQueueSend(queue, &buf, portMAX_DELAY);
+  }
+
+  size_t receive(void* data) {
+    RingbufHandle_t handle;
+    xQueueReceive(queue, &handle, portMAX_DELAY);
+    size_t len{};
+    auto const item{xRingbufferReceive(handle, &len, portMAX_DELAY)};
+    std::memcpy(data, item, len);
+    vRingbufferReturnItem(handle, item);
+    return len;
+  }
+
+  RingbufHandle_t buf;
+  QueueHandle_t queue;
+};
+
+struct Adapter {
+  bool send(void const* data, size_t len) {
+    return channel.send(data, len, portMAX_DELAY);
+  }
+
+  size_t receive(void* data) {
+    auto const item{channel.receive(portMAX_DELAY)};
+    size_t const len{item->len};
+    std::memcpy(data, item->data, len);
+    channel.release();
+    return len;
+  }
+
+  channel_t channel;
+};
+
+/// Push count items of len bytes through t
+///
+/// \return Nanoseconds per item
+template<typename T>
+double stream(size_t count, size_t len) {
+  T t;
+  uint8_t src[max_item]{};
+  auto const start{steady_clock::now()};
+  std::thread producer{[&] {
+    for (size_t i{}; i < count; ++i) t.send(src, len);
+  }};
+  uint8_t dst[max_item];
+  for (size_t i{}; i < count; ++i) t.receive(dst);
+  producer.join();
+  return static_cast<double>(
+           duration_cast<nanoseconds>(steady_clock::now() - start).count()) /
+         static_cast<double>(count);
+}
+
+/// Bounce an item of len bytes count times between two tasks
+///
+/// \return Nanoseconds per round trip
+template<typename T>
+double ping_pong(size_t count, size_t len) {
+  T ping, pong;
+  auto const start{steady_clock::now()};
+  std::thread echo{[&] {
+    uint8_t buf[max_item];
+    for (size_t i{}; i < count; ++i) pong.send(buf, ping.receive(buf));
+  }};
+  uint8_t buf[max_item]{};
+  for (size_t i{}; i < count; ++i) {
+    ping.send(buf, len);
+    pong.receive(buf);
+  }
+  echo.join();
+  return static_cast<double>(
+           duration_cast<nanoseconds>(steady_clock::now() - start).count()) /
+         static_cast<double>(count);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t const count{argc > 1 ? std::strtoull(argv[1], nullptr, 0) : 100'000u};
+
+  std::printf("%-10s %6s %14s %14s\n", "bench", "len", "ringbuf+queue",
+              "channel");
+  for (auto const len : {16u, 256u, 1024u})
+    std::printf("%-10s %6u %11.0f ns %11.0f ns\n",
+                "stream",
+                len,
+                stream<Pair>(count, len),
+                stream<Adapter>(count, len));
+  for (auto const len : {1u, 16u, 256u})
+    std::printf("%-10s %6u %11.0f ns %11.0f ns\n",
+                "ping-pong",
+                len,
+                ping_pong<Pair>(count / 10u, len),
+                ping_pong<Adapter>(count / 10u, len));
+  return EXIT_SUCCESS;
+}
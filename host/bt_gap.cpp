@@ -0,0 +1,69 @@
+/// BT GAP stand-in for the host build
+///
+/// There is nothing to discover on the host. The remote address is chosen such
+/// that spp_master_or_slave picks the requested role and SPP gets initialized
+/// right away. A hub gets bt_max_peers remote addresses. Power events of the
+/// virtual link get forwarded just like the real callback does.
+///
+/// \file   bt_gap.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_bt_device.h>
+#include <esp_gap_bt_api.h>
+#include <bt_gap.hpp>
+#include <bt_spp.hpp>
+#include <cstring>
+#include "host.hpp"
+#include "power.hpp"
+
+/// Own BT device address
+esp_bd_addr_t own_bda{};
+
+/// Remote BT device addresses
+esp_bd_addr_t remote_bdas[bt_max_peers]{};
+
+/// Number of remote BT device addresses
+size_t remote_count{};
+
+/// Remote device is a hub
+bool remote_hub{};
+
+namespace {
+
+esp_spp_role_t role{ESP_SPP_ROLE_MASTER};
+
+void gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t* param) {
+  switch (event) {
+    case ESP_BT_GAP_QOS_CMPL_EVT:
+      if (param->qos_cmpl.stat == ESP_BT_STATUS_SUCCESS)
+        power_qos_done(param->qos_cmpl.bda, param->qos_cmpl.t_poll);
+      break;
+    case ESP_BT_GAP_MODE_CHG_EVT:
+      power_mode_changed(param->mode_chg.mode == ESP_BT_PM_MD_SNIFF);
+      break;
+    default: break;
+  }
+}
+
+}  // namespace
+
+void host_gap_set_role(esp_spp_role_t spp_role) { role = spp_role; }
+
+/// Initialize BT GAP
+void bt_gap_init() {
+  esp_bt_gap_register_callback(gap_cb);
+  memcpy(own_bda, esp_bt_dev_get_address(), sizeof(esp_bd_addr_t));
+  bt_gap_start_discovery();
+}
+
+/// Pick the remote addresses again and initialize BT SPP
+void bt_gap_start_discovery() {
+  remote_count = bt_hub ? bt_max_peers : 1u;
+  for (size_t i{}; i < remote_count; ++i) {
+    memcpy(remote_bdas[i], own_bda, sizeof(esp_bd_addr_t));
+    remote_bdas[i][ESP_BD_ADDR_LEN - 1] +=
+      role == ESP_SPP_ROLE_MASTER ? -1 - static_cast<int>(i) : 1;
+  }
+  bt_spp_init();
+}
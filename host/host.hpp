@@ -0,0 +1,75 @@
+/// Host
+///
+/// Knobs of the host-native build which have no ESP-IDF equivalent. They
+/// describe the world around the bridge (serial line, radio link, peer) and
+/// must be set before app_main runs.
+///
+/// \file   host.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <driver/uart.h>
+#include <esp_spp_api.h>
+#include <cstddef>
+#include <cstdint>
+
+/// Virtual SPP link
+///
+/// Writes get split into RFCOMM frames of at most mtu bytes. Each frame plus
+/// its header is sent as a sequence of baseband packets carrying up to
+/// packet_payload bytes and occupying the air for packet_us each. Frames
+/// arrive latency_us after they left. The link is congested as long as more
+/// than window bytes wait for the air. Discovery reports service_name as the
+/// peer's SDP service name.
+struct host_link_config {
+  uint16_t mtu{ESP_SPP_MAX_MTU};
+  uint16_t frame_overhead{9};
+  uint16_t packet_payload{1021};
+  uint32_t packet_us{3750};
+  uint32_t latency_us{5000};
+  uint32_t window{4 * ESP_SPP_MAX_MTU};
+  char const* service_name{};
+};
+
+/// Configure the virtual SPP link
+void host_spp_set_link(host_link_config const& config);
+
+/// Wait until the bridge got count SPP connection opened events
+void host_spp_wait_open(size_t count = 1u);
+
+/// Drop all SPP connections, data on the air gets lost
+void host_spp_drop();
+
+/// Pair with another host bridge through a Unix socket instead of looping back
+///
+/// The server side listens on path, the master connects to it. Both wait for
+/// the other one to start.
+///
+/// \param  path        Path of the socket
+/// \param  server_side Bridge is the SPP slave
+/// \return false if the other bridge didn't show up
+bool host_spp_pair(char const* path, bool server_side);
+
+/// Wait until the paired bridge is gone
+void host_spp_wait_unpaired();
+
+/// Let the bridge become SPP master (inquiry side) or slave (server side)
+void host_gap_set_role(esp_spp_role_t role);
+
+/// Set the baud rate of the host side of the serial line
+///
+/// The auto baud pulse counters of the port follow this rate.
+void host_uart_set_line_baud(uart_port_t uart_num, int baud_rate);
+
+/// Get the master side of the pseudo-terminal backing an UART port
+///
+/// \return File descriptor or -1 if the driver isn't installed yet
+int host_uart_master_fd(uart_port_t uart_num);
+
+/// Check whether an UART port asserts RTS (ready to receive)
+///
+/// Nothing stops writes to the pseudo-terminal, the host side has to honor
+/// this on its own.
+bool host_uart_rts(uart_port_t uart_num);
@@ -0,0 +1,119 @@
+/// Host shim for driver/uart.h
+///
+/// Every UART port is backed by a Linux pseudo-terminal which gets opened by
+/// uart_driver_install. The bridge reads and writes the slave side, the master
+/// side is handed out through host.hpp. A driver thread moves received data
+/// into the RX buffer and raises events like the RX interrupt would.
+///
+/// \file   uart.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+using uart_port_t = int;
+
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+#define UART_NUM_2 2
+#define UART_NUM_MAX 3
+
+#define UART_PIN_NO_CHANGE (-1)
+
+enum uart_word_length_t {
+  UART_DATA_5_BITS,
+  UART_DATA_6_BITS,
+  UART_DATA_7_BITS,
+  UART_DATA_8_BITS,
+  UART_DATA_BITS_MAX
+};
+
+enum uart_parity_t {
+  UART_PARITY_DISABLE = 0x0,
+  UART_PARITY_EVEN = 0x2,
+  UART_PARITY_ODD = 0x3
+};
+
+enum uart_stop_bits_t {
+  UART_STOP_BITS_1 = 0x1,
+  UART_STOP_BITS_1_5 = 0x2,
+  UART_STOP_BITS_2 = 0x3,
+  UART_STOP_BITS_MAX
+};
+
+enum uart_hw_flowcontrol_t {
+  UART_HW_FLOWCTRL_DISABLE = 0x0,
+  UART_HW_FLOWCTRL_RTS = 0x1,
+  UART_HW_FLOWCTRL_CTS = 0x2,
+  UART_HW_FLOWCTRL_CTS_RTS = 0x3,
+  UART_HW_FLOWCTRL_MAX
+};
+
+enum uart_sclk_t { UART_SCLK_APB, UART_SCLK_DEFAULT = UART_SCLK_APB };
+
+enum uart_event_type_t {
+  UART_DATA,
+  UART_BREAK,
+  UART_BUFFER_FULL,
+  UART_FIFO_OVF,
+  UART_FRAME_ERR,
+  UART_PARITY_ERR,
+  UART_DATA_BREAK,
+  UART_PATTERN_DET,
+  UART_EVENT_MAX
+};
+
+struct uart_event_t {
+  uart_event_type_t type;
+  size_t size;
+  bool timeout_flag;
+};
+
+struct uart_config_t {
+  int baud_rate;
+  uart_word_length_t data_bits;
+  uart_parity_t parity;
+  uart_stop_bits_t stop_bits;
+  uart_hw_flowcontrol_t flow_ctrl;
+  uint8_t rx_flow_ctrl_thresh;
+  uart_sclk_t source_clk;
+};
+
+esp_err_t uart_param_config(uart_port_t uart_num,
+                            uart_config_t const* uart_config);
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate);
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t* baudrate);
+esp_err_t uart_set_pin(uart_port_t uart_num,
+                       int tx_io_num,
+                       int rx_io_num,
+                       int rts_io_num,
+                       int cts_io_num);
+esp_err_t uart_driver_install(uart_port_t uart_num,
+                              int rx_buffer_size,
+                              int tx_buffer_size,
+                              int queue_size,
+                              QueueHandle_t* uart_queue,
+                              int intr_alloc_flags);
+int uart_read_bytes(uart_port_t uart_num,
+                    void* buf,
+                    uint32_t length,
+                    TickType_t ticks_to_wait);
+int uart_write_bytes(uart_port_t uart_num, void const* src, size_t size);
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t* size);
+esp_err_t uart_set_rx_full_threshold(uart_port_t uart_num, int threshold);
+esp_err_t uart_set_rx_timeout(uart_port_t uart_num, uint8_t tout_thresh);
+esp_err_t uart_flush_input(uart_port_t uart_num);
+esp_err_t uart_set_rts(uart_port_t uart_num, int level);
+esp_err_t uart_set_sw_flow_ctrl(uart_port_t uart_num,
+                                bool enable,
+                                uint8_t rx_thresh_xon,
+                                uint8_t rx_thresh_xoff);
+esp_err_t uart_set_hw_flow_ctrl(uart_port_t uart_num,
+                                uart_hw_flowcontrol_t flow_ctrl,
+                                uint8_t rx_thresh);
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait);
+esp_err_t uart_set_wakeup_threshold(uart_port_t uart_num, int wakeup_threshold);
@@ -0,0 +1,11 @@
+/// Host shim for esp_attr.h
+///
+/// \file   esp_attr.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#define DMA_ATTR
+#define DRAM_ATTR
+#define IRAM_ATTR
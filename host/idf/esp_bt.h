@@ -0,0 +1,27 @@
+/// Host shim for esp_bt.h
+///
+/// \file   esp_bt.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_err.h"
+
+enum esp_bt_mode_t {
+  ESP_BT_MODE_IDLE = 0x00,
+  ESP_BT_MODE_BLE = 0x01,
+  ESP_BT_MODE_CLASSIC_BT = 0x02,
+  ESP_BT_MODE_BTDM = 0x03
+};
+
+struct esp_bt_controller_config_t {
+  int mode;
+};
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT()                                    \
+  { .mode = ESP_BT_MODE_CLASSIC_BT }
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
@@ -0,0 +1,15 @@
+/// Host shim for esp_bt_defs.h
+///
+/// \file   esp_bt_defs.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdint>
+
+#define ESP_BD_ADDR_LEN 6
+
+using esp_bd_addr_t = uint8_t[ESP_BD_ADDR_LEN];
+
+enum esp_bt_status_t { ESP_BT_STATUS_SUCCESS = 0, ESP_BT_STATUS_FAIL };
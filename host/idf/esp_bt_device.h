@@ -0,0 +1,13 @@
+/// Host shim for esp_bt_device.h
+///
+/// \file   esp_bt_device.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_bt_defs.h"
+#include "esp_err.h"
+
+uint8_t const* esp_bt_dev_get_address();
+esp_err_t esp_bt_dev_set_device_name(char const* name);
@@ -0,0 +1,12 @@
+/// Host shim for esp_bt_main.h
+///
+/// \file   esp_bt_main.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_err.h"
+
+esp_err_t esp_bluedroid_init();
+esp_err_t esp_bluedroid_enable();
@@ -0,0 +1,37 @@
+/// Host shim for esp_err.h
+///
+/// \file   esp_err.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+using esp_err_t = int;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_TIMEOUT 0x107
+
+char const* esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK(x)                                                     \
+  do {                                                                         \
+    esp_err_t const err_rc_{x};                                                \
+    if (err_rc_ != ESP_OK) {                                                   \
+      std::fprintf(stderr,                                                     \
+                   "ESP_ERROR_CHECK failed: %s at %s:%d\n",                    \
+                   esp_err_to_name(err_rc_),                                   \
+                   __FILE__,                                                   \
+                   __LINE__);                                                  \
+      std::abort();                                                            \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,49 @@
+/// Host shim for esp_gap_bt_api.h
+///
+/// GAP itself is not emulated, the host build replaces bt_gap.cpp with a
+/// stand-in which skips inquiry. Only QoS setup gets modelled, the poll
+/// interval of the virtual link.
+///
+/// \file   esp_gap_bt_api.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_bt_defs.h"
+#include "esp_err.h"
+
+#define ESP_BT_GAP_TPOLL_MIN (0x0006)
+#define ESP_BT_GAP_TPOLL_DFT (0x0028)
+#define ESP_BT_GAP_TPOLL_MAX (0x1000)
+
+enum esp_bt_pm_mode_t {
+  ESP_BT_PM_MD_ACTIVE = 0x00,
+  ESP_BT_PM_MD_HOLD = 0x01,
+  ESP_BT_PM_MD_SNIFF = 0x02,
+  ESP_BT_PM_MD_PARK = 0x03
+};
+
+enum esp_bt_gap_cb_event_t {
+  ESP_BT_GAP_QOS_CMPL_EVT,
+  ESP_BT_GAP_MODE_CHG_EVT,
+  ESP_BT_GAP_EVT_MAX
+};
+
+union esp_bt_gap_cb_param_t {
+  struct {
+    esp_bt_status_t stat;
+    esp_bd_addr_t bda;
+    uint32_t t_poll;
+  } qos_cmpl;
+  struct {
+    esp_bd_addr_t bda;
+    esp_bt_pm_mode_t mode;
+  } mode_chg;
+};
+
+using esp_bt_gap_cb_t = void (*)(esp_bt_gap_cb_event_t event,
+                                 esp_bt_gap_cb_param_t* param);
+
+esp_err_t esp_bt_gap_register_callback(esp_bt_gap_cb_t callback);
+esp_err_t esp_bt_gap_set_qos(esp_bd_addr_t remote_bda, uint32_t t_poll);
@@ -0,0 +1,20 @@
+/// Host shim for esp_intr_alloc.h
+///
+/// \file   esp_intr_alloc.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_err.h"
+
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+using intr_handler_t = void (*)(void*);
+using intr_handle_t = struct intr_handle_data_t*;
+
+esp_err_t esp_intr_alloc(int source,
+                         int flags,
+                         intr_handler_t handler,
+                         void* arg,
+                         intr_handle_t* ret_handle);
@@ -0,0 +1,36 @@
+/// Host shim for esp_log.h
+///
+/// \file   esp_log.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdint>
+
+enum esp_log_level_t {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE
+};
+
+void esp_log_level_set(char const* tag, esp_log_level_t level);
+void esp_log_write(esp_log_level_t level,
+                   char const* tag,
+                   char const* format,
+                   ...) __attribute__((format(printf, 3, 4)));
+void esp_log_buffer_hex(char const* tag, void const* buffer, uint16_t len);
+
+#define ESP_LOGE(tag, format, ...)                                             \
+  esp_log_write(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)                                             \
+  esp_log_write(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)                                             \
+  esp_log_write(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)                                             \
+  esp_log_write(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)                                             \
+  esp_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
@@ -0,0 +1,33 @@
+/// Host shim for esp_pm.h
+///
+/// The host doesn't sleep, esp_pm_configure always fails.
+///
+/// \file   esp_pm.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_err.h"
+
+enum esp_pm_lock_type_t {
+  ESP_PM_CPU_FREQ_MAX,
+  ESP_PM_APB_FREQ_MAX,
+  ESP_PM_NO_LIGHT_SLEEP
+};
+
+struct esp_pm_config_t {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+};
+
+using esp_pm_lock_handle_t = struct esp_pm_lock*;
+
+esp_err_t esp_pm_configure(void const* config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type,
+                             int arg,
+                             char const* name,
+                             esp_pm_lock_handle_t* out_handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
@@ -0,0 +1,11 @@
+/// Host shim for esp_private/periph_ctrl.h
+///
+/// \file   periph_ctrl.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <soc/periph_defs.h>
+
+void periph_module_enable(periph_module_t periph);
@@ -0,0 +1,11 @@
+/// Host shim for esp_random.h
+///
+/// \file   esp_random.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdint>
+
+uint32_t esp_random();
@@ -0,0 +1,11 @@
+/// Host shim for esp_sleep.h
+///
+/// \file   esp_sleep.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_uart_wakeup(int uart_num);
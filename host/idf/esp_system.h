@@ -0,0 +1,18 @@
+/// Host shim for esp_system.h
+///
+/// The host has no heap limit worth reporting, heap sizes read 0.
+///
+/// \file   esp_system.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_attr.h"
+#include "esp_err.h"
+
+#include <cstdint>
+
+[[noreturn]] void esp_restart();
+uint32_t esp_get_free_heap_size();
+uint32_t esp_get_minimum_free_heap_size();
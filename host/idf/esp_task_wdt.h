@@ -0,0 +1,12 @@
+/// Host shim for esp_task_wdt.h
+///
+/// \file   esp_task_wdt.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "esp_err.h"
+
+/// There is no task watchdog on the host
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
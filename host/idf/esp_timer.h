@@ -0,0 +1,32 @@
+/// Host shim for esp_timer.h
+///
+/// \file   esp_timer.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdint>
+#include "esp_err.h"
+
+/// Microseconds since boot
+int64_t esp_timer_get_time();
+
+using esp_timer_cb_t = void (*)(void* arg);
+
+enum esp_timer_dispatch_t { ESP_TIMER_TASK };
+
+struct esp_timer_create_args_t {
+  esp_timer_cb_t callback;
+  void* arg;
+  esp_timer_dispatch_t dispatch_method;
+  char const* name;
+  bool skip_unhandled_events;
+};
+
+using esp_timer_handle_t = struct esp_timer*;
+
+esp_err_t esp_timer_create(esp_timer_create_args_t const* create_args,
+                           esp_timer_handle_t* out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
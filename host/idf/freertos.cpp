@@ -0,0 +1,408 @@
+/// Host shim for FreeRTOS tasks, queues, mutexes and ring buffers
+///
+/// \file   freertos.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <pthread.h>
+#include <time.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+struct tskTaskControlBlock {
+  std::string name;
+  uint32_t stack_depth{};
+  BaseType_t core{tskNO_AFFINITY};
+  std::atomic<clockid_t> clock{};  ///< CPU time clock of the thread
+  bool idle{};
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint32_t notification_value{};
+};
+
+struct QueueDefinition {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t item_size;
+};
+
+struct SemaphoreDefinition {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool taken;
+};
+
+struct Ringbuffer_t {
+  struct Item {
+    std::unique_ptr<uint8_t[]> data;
+    size_t len;
+    bool complete;
+    bool received;
+  };
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::list<Item> items;
+  size_t size;
+  size_t used;
+};
+
+namespace {
+
+/// Ring buffer item header size of ESP-IDF
+constexpr size_t ringbuf_header_size{8};
+
+auto const boot{steady_clock::now()};
+thread_local TaskHandle_t current_task{nullptr};
+
+/// Tasks created so far, guarded by tasks_mutex
+std::mutex tasks_mutex;
+std::vector<TaskHandle_t> tasks;
+
+/// CPU time of a task's thread [us]
+int64_t cpu_time(TaskHandle_t task) {
+  timespec ts{};
+  if (auto const clock{task->clock.load()};
+      !clock || clock_gettime(clock, &ts))
+    return 0;
+  return int64_t{ts.tv_sec} * 1'000'000 + ts.tv_nsec / 1'000;
+}
+
+/// Idle time of a core, what its tasks left of the wall time [us]
+int64_t idle_time(BaseType_t core) {
+  int64_t busy{};
+  {
+    std::lock_guard lock{tasks_mutex};
+    for (auto const task : tasks)
+      if (task->core == core) busy += 2 * cpu_time(task);
+      else if (task->core == tskNO_AFFINITY) busy += cpu_time(task);
+  }
+  auto const wall{duration_cast<microseconds>(steady_clock::now() - boot)};
+  return std::max<int64_t>(wall.count() - busy / 2, 0);
+}
+
+/// Convert ticks to an absolute deadline
+///
+/// \param  ticks Ticks to wait
+/// \return Deadline, time_point::max() for portMAX_DELAY
+steady_clock::time_point deadline(TickType_t ticks) {
+  if (ticks == portMAX_DELAY) return steady_clock::time_point::max();
+  return steady_clock::now() +
+         microseconds{uint64_t{ticks} * 1'000'000 / configTICK_RATE_HZ};
+}
+
+/// Wait on condition variable until predicate is true or deadline passed
+template<typename Lock, typename Predicate>
+bool wait_until(std::condition_variable& cv,
+                Lock& lock,
+                steady_clock::time_point tp,
+                Predicate pred) {
+  if (tp == steady_clock::time_point::max()) {
+    cv.wait(lock, pred);
+    return true;
+  }
+  return cv.wait_until(lock, tp, pred);
+}
+
+/// Task control block of the calling thread
+///
+/// Threads which weren't created through xTaskCreatePinnedToCore (e.g. the
+/// BTC thread of the SPP shim) get one on first use.
+TaskHandle_t self() {
+  if (!current_task) {
+    current_task = new tskTaskControlBlock;
+    current_task->name = "thread";
+  }
+  return current_task;
+}
+
+/// Space a ring buffer item occupies including header and alignment
+size_t ringbuf_item_size(size_t len) {
+  return ringbuf_header_size + ((len + 3) & ~size_t{3});
+}
+
+}  // namespace
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode,
+                                   char const* pcName,
+                                   uint32_t usStackDepth,
+                                   void* pvParameters,
+                                   UBaseType_t,
+                                   TaskHandle_t* pvCreatedTask,
+                                   BaseType_t xCoreID) {
+  auto task{new tskTaskControlBlock};
+  task->name = pcName ? pcName : "";
+  task->stack_depth = usStackDepth;
+  task->core = xCoreID;
+  if (pvCreatedTask) *pvCreatedTask = task;
+  {
+    std::lock_guard lock{tasks_mutex};
+    tasks.push_back(task);
+  }
+  std::thread{[=] {
+    current_task = task;
+    clockid_t clock{};
+    if (!pthread_getcpuclockid(pthread_self(), &clock)) task->clock = clock;
+    pvTaskCode(pvParameters);
+  }}.detach();
+  return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t pvTaskCode,
+                                          char const* pcName,
+                                          uint32_t ulStackDepth,
+                                          void* pvParameters,
+                                          UBaseType_t uxPriority,
+                                          StackType_t*,
+                                          StaticTask_t*,
+                                          BaseType_t xCoreID) {
+  TaskHandle_t task{nullptr};
+  xTaskCreatePinnedToCore(pvTaskCode,
+                          pcName,
+                          ulStackDepth,
+                          pvParameters,
+                          uxPriority,
+                          &task,
+                          xCoreID);
+  return task;
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+  std::this_thread::sleep_until(deadline(xTicksToDelay));
+}
+
+TickType_t xTaskGetTickCount() {
+  return static_cast<TickType_t>(
+    duration_cast<microseconds>(steady_clock::now() - boot).count() *
+    configTICK_RATE_HZ / 1'000'000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return self(); }
+
+char* pcTaskGetName(TaskHandle_t xTaskToQuery) {
+  return data((xTaskToQuery ? xTaskToQuery : self())->name);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+  return (xTask ? xTask : self())->stack_depth;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t xCoreID) {
+  static auto const idle_tasks{[] {
+    std::array<TaskHandle_t, portNUM_PROCESSORS> retval{};
+    for (size_t i{}; i < size(retval); ++i) {
+      retval[i] = new tskTaskControlBlock;
+      retval[i]->name = "IDLE" + std::to_string(i);
+      retval[i]->core = static_cast<BaseType_t>(i);
+      retval[i]->idle = true;
+    }
+    return retval;
+  }()};
+  return xCoreID >= 0 && xCoreID < portNUM_PROCESSORS ? idle_tasks[xCoreID]
+                                                     : nullptr;
+}
+
+uint32_t ulTaskGetRunTimeCounter(TaskHandle_t xTask) {
+  auto const task{xTask ? xTask : self()};
+  return static_cast<uint32_t>(task->idle ? idle_time(task->core)
+                                          : cpu_time(task));
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+  std::lock_guard lock{xTaskToNotify->mutex};
+  ++xTaskToNotify->notification_value;
+  xTaskToNotify->cv.notify_all();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit,
+                          TickType_t xTicksToWait) {
+  auto task{self()};
+  std::unique_lock lock{task->mutex};
+  wait_until(task->cv, lock, deadline(xTicksToWait), [task] {
+    return task->notification_value != 0u;
+  });
+  auto const value{task->notification_value};
+  if (value) task->notification_value = xClearCountOnExit ? 0u : value - 1u;
+  return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
+  auto queue{new QueueDefinition};
+  queue->length = uxQueueLength;
+  queue->item_size = uxItemSize;
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue,
+                      void const* pvItemToQueue,
+                      TickType_t xTicksToWait) {
+  std::unique_lock lock{xQueue->mutex};
+  if (!wait_until(xQueue->cv, lock, deadline(xTicksToWait), [xQueue] {
+        return xQueue->items.size() < xQueue->length;
+      }))
+    return pdFALSE;
+  auto const p{static_cast<uint8_t const*>(pvItemToQueue)};
+  xQueue->items.emplace_back(p, p + xQueue->item_size);
+  xQueue->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue,
+                         void* pvBuffer,
+                         TickType_t xTicksToWait) {
+  std::unique_lock lock{xQueue->mutex};
+  if (!wait_until(xQueue->cv, lock, deadline(xTicksToWait), [xQueue] {
+        return !xQueue->items.empty();
+      }))
+    return pdFALSE;
+  memcpy(pvBuffer, data(xQueue->items.front()), xQueue->item_size);
+  xQueue->items.pop_front();
+  xQueue->cv.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
+  std::lock_guard lock{xQueue->mutex};
+  return static_cast<UBaseType_t>(size(xQueue->items));
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t*) {
+  auto semaphore{new SemaphoreDefinition};
+  semaphore->taken = false;
+  return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore,
+                          TickType_t xBlockTime) {
+  std::unique_lock lock{xSemaphore->mutex};
+  if (!wait_until(xSemaphore->cv, lock, deadline(xBlockTime), [xSemaphore] {
+        return !xSemaphore->taken;
+      }))
+    return pdFALSE;
+  xSemaphore->taken = true;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+  std::lock_guard lock{xSemaphore->mutex};
+  if (!xSemaphore->taken) return pdFALSE;
+  xSemaphore->taken = false;
+  xSemaphore->cv.notify_all();
+  return pdTRUE;
+}
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize,
+                                  RingbufferType_t xBufferType) {
+  if (xBufferType != RINGBUF_TYPE_NOSPLIT) return nullptr;
+  auto ringbuf{new Ringbuffer_t};
+  ringbuf->size = (xBufferSize + 3) & ~size_t{3};
+  ringbuf->used = 0;
+  return ringbuf;
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer,
+                           void const* pvItem,
+                           size_t xItemSize,
+                           TickType_t xTicksToWait) {
+  void* item;
+  if (!xRingbufferSendAcquire(xRingbuffer, &item, xItemSize, xTicksToWait))
+    return pdFALSE;
+  memcpy(item, pvItem, xItemSize);
+  return xRingbufferSendComplete(xRingbuffer, item);
+}
+
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer,
+                                  void** ppvItem,
+                                  size_t xItemSize,
+                                  TickType_t xTicksToWait) {
+  if (xItemSize > xRingbufferGetMaxItemSize(xRingbuffer)) return pdFALSE;
+  auto const item_size{ringbuf_item_size(xItemSize)};
+  std::unique_lock lock{xRingbuffer->mutex};
+  if (!wait_until(
+        xRingbuffer->cv, lock, deadline(xTicksToWait), [=] {
+          return xRingbuffer->used + item_size <= xRingbuffer->size;
+        }))
+    return pdFALSE;
+  auto& item{xRingbuffer->items.emplace_back(
+    Ringbuffer_t::Item{std::make_unique<uint8_t[]>(xItemSize ? xItemSize : 1),
+                       xItemSize,
+                       false,
+                       false})};
+  xRingbuffer->used += item_size;
+  *ppvItem = item.data.get();
+  return pdTRUE;
+}
+
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void* pvItem) {
+  std::lock_guard lock{xRingbuffer->mutex};
+  for (auto& item : xRingbuffer->items)
+    if (item.data.get() == pvItem && !item.complete) {
+      item.complete = true;
+      xRingbuffer->cv.notify_all();
+      return pdTRUE;
+    }
+  return pdFALSE;
+}
+
+void* xRingbufferReceive(RingbufHandle_t xRingbuffer,
+                         size_t* pxItemSize,
+                         TickType_t xTicksToWait) {
+  std::unique_lock lock{xRingbuffer->mutex};
+  // Items are received in order, an incomplete item blocks those behind it
+  auto const next{[xRingbuffer] {
+    for (auto it{begin(xRingbuffer->items)}; it != end(xRingbuffer->items);
+         ++it)
+      if (!it->received) return it->complete ? it : end(xRingbuffer->items);
+    return end(xRingbuffer->items);
+  }};
+  if (!wait_until(xRingbuffer->cv, lock, deadline(xTicksToWait), [&] {
+        return next() != end(xRingbuffer->items);
+      }))
+    return nullptr;
+  auto it{next()};
+  it->received = true;
+  if (pxItemSize) *pxItemSize = it->len;
+  return it->data.get();
+}
+
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void* pvItem) {
+  std::lock_guard lock{xRingbuffer->mutex};
+  for (auto it{begin(xRingbuffer->items)}; it != end(xRingbuffer->items); ++it)
+    if (it->data.get() == pvItem) {
+      xRingbuffer->used -= ringbuf_item_size(it->len);
+      xRingbuffer->items.erase(it);
+      xRingbuffer->cv.notify_all();
+      return;
+    }
+}
+
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t xRingbuffer) {
+  return xRingbuffer->size / 2 - ringbuf_header_size;
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer) {
+  std::lock_guard lock{xRingbuffer->mutex};
+  auto const free{xRingbuffer->size - xRingbuffer->used};
+  return free > ringbuf_header_size ? free - ringbuf_header_size : 0;
+}
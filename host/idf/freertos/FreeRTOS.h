@@ -0,0 +1,36 @@
+/// Host shim for freertos/FreeRTOS.h
+///
+/// \file   FreeRTOS.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_attr.h"
+#include "esp_err.h"
+
+using BaseType_t = int;
+using UBaseType_t = unsigned int;
+using TickType_t = uint32_t;
+using StackType_t = uint8_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+/// Same tick rate as the ESP-IDF default (CONFIG_FREERTOS_HZ)
+#define configTICK_RATE_HZ 100
+#define portMAX_DELAY (TickType_t)0xFFFFFFFFUL
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs)                                               \
+  ((TickType_t)(((uint64_t)(xTimeInMs) * configTICK_RATE_HZ) / 1000U))
+
+#define portYIELD_FROM_ISR(xSwitchRequired) static_cast<void>(xSwitchRequired)
+
+#define portNUM_PROCESSORS 2
+#define PRO_CPU_NUM 0
+#define APP_CPU_NUM 1
+#define tskNO_AFFINITY 0x7FFFFFFF
@@ -0,0 +1,20 @@
+/// Host shim for freertos/queue.h
+///
+/// \file   queue.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+using QueueHandle_t = struct QueueDefinition*;
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize);
+BaseType_t xQueueSend(QueueHandle_t xQueue,
+                      void const* pvItemToQueue,
+                      TickType_t xTicksToWait);
+BaseType_t xQueueReceive(QueueHandle_t xQueue,
+                         void* pvBuffer,
+                         TickType_t xTicksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue);
@@ -0,0 +1,40 @@
+/// Host shim for freertos/ringbuf.h
+///
+/// Only no-split ring buffers are emulated. Every item is accounted with the
+/// same 8 byte header and 4 byte alignment as the ESP-IDF implementation so
+/// that buffer sizes behave alike, wrap-around fragmentation is not modeled.
+///
+/// \file   ringbuf.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+using RingbufHandle_t = struct Ringbuffer_t*;
+
+enum RingbufferType_t {
+  RINGBUF_TYPE_NOSPLIT,
+  RINGBUF_TYPE_ALLOWSPLIT,
+  RINGBUF_TYPE_BYTEBUF,
+  RINGBUF_TYPE_MAX
+};
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize,
+                                  RingbufferType_t xBufferType);
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer,
+                           void const* pvItem,
+                           size_t xItemSize,
+                           TickType_t xTicksToWait);
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer,
+                                  void** ppvItem,
+                                  size_t xItemSize,
+                                  TickType_t xTicksToWait);
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void* pvItem);
+void* xRingbufferReceive(RingbufHandle_t xRingbuffer,
+                         size_t* pxItemSize,
+                         TickType_t xTicksToWait);
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void* pvItem);
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t xRingbuffer);
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer);
@@ -0,0 +1,20 @@
+/// Host shim for freertos/semphr.h
+///
+/// Only mutexes are supported. Static mutexes ignore the buffer they get.
+///
+/// \file   semphr.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+using SemaphoreHandle_t = struct SemaphoreDefinition*;
+
+struct StaticSemaphore_t {};
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* pxMutexBuffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore,
+                          TickType_t xBlockTime);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
@@ -0,0 +1,52 @@
+/// Host shim for freertos/task.h
+///
+/// Tasks are mapped onto detached std::threads. Priorities and core affinity
+/// are accepted but ignored. Stack usage can't be measured, the stack high
+/// water mark is the full stack depth. Static tasks ignore the buffers they
+/// get, their threads have stacks of their own.
+///
+/// Run time is the CPU time of a task's thread in us. Every core has an idle
+/// task whose run time is whatever the tasks pinned to that core left of the
+/// wall time, tasks without affinity count half on each core. Host threads run
+/// in parallel, so a core whose tasks took more than the wall time reports no
+/// idle time at all.
+///
+/// \file   task.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+using TaskFunction_t = void (*)(void*);
+using TaskHandle_t = struct tskTaskControlBlock*;
+struct StaticTask_t {};
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode,
+                                   char const* pcName,
+                                   uint32_t usStackDepth,
+                                   void* pvParameters,
+                                   UBaseType_t uxPriority,
+                                   TaskHandle_t* pvCreatedTask,
+                                   BaseType_t xCoreID);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t pvTaskCode,
+                                          char const* pcName,
+                                          uint32_t ulStackDepth,
+                                          void* pvParameters,
+                                          UBaseType_t uxPriority,
+                                          StackType_t* pxStackBuffer,
+                                          StaticTask_t* pxTaskBuffer,
+                                          BaseType_t xCoreID);
+void vTaskDelay(TickType_t xTicksToDelay);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+char* pcTaskGetName(TaskHandle_t xTaskToQuery);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask);
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t xCoreID);
+uint32_t ulTaskGetRunTimeCounter(TaskHandle_t xTask);
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify,
+                            BaseType_t* pxHigherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit,
+                          TickType_t xTicksToWait);
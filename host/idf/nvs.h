@@ -0,0 +1,37 @@
+/// Host shim for nvs.h
+///
+/// \file   nvs.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND (ESP_ERR_NVS_BASE + 0x10)
+
+using nvs_handle_t = uint32_t;
+
+enum nvs_open_mode_t { NVS_READONLY, NVS_READWRITE };
+
+esp_err_t nvs_open(char const* name,
+                   nvs_open_mode_t open_mode,
+                   nvs_handle_t* out_handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle,
+                       char const* key,
+                       void* out_value,
+                       size_t* length);
+esp_err_t nvs_set_blob(nvs_handle_t handle,
+                       char const* key,
+                       void const* value,
+                       size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, char const* key);
+esp_err_t nvs_commit(nvs_handle_t handle);
+void nvs_close(nvs_handle_t handle);
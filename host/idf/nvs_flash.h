@@ -0,0 +1,12 @@
+/// Host shim for nvs_flash.h
+///
+/// \file   nvs_flash.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init();
+esp_err_t nvs_flash_erase();
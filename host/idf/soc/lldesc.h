@@ -0,0 +1,25 @@
+/// Host shim for soc/lldesc.h
+///
+/// Same layout and qualifiers as ESP-IDF, so code which touches descriptors
+/// has to deal with the volatile buffer pointer just like on the target.
+///
+/// \file   lldesc.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdint>
+
+struct lldesc_s {
+  volatile uint32_t size : 12, length : 12, offset : 5, sosf : 1, eof : 1,
+    owner : 1;
+  volatile uint8_t const* buf;
+  union {
+    volatile uint32_t empty;
+    struct {
+      lldesc_s* stqe_next;
+    } qe;
+  };
+};
+using lldesc_t = lldesc_s;
@@ -0,0 +1,15 @@
+/// Host shim for soc/periph_defs.h
+///
+/// \file   periph_defs.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+enum periph_module_t {
+  PERIPH_UHCI0_MODULE = 19,
+  PERIPH_UHCI1_MODULE = 20,
+};
+
+#define ETS_UHCI0_INTR_SOURCE 12
+#define ETS_UHCI1_INTR_SOURCE 13
@@ -0,0 +1,40 @@
+/// Host shim for soc/uart_struct.h
+///
+/// Only the auto baud, flow control, idle and status registers used by the
+/// bridge exist. The pulse counters are derived from the line baud rate set
+/// through host.hpp, the other registers are ignored.
+///
+/// \file   uart_struct.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdint>
+
+struct uart_dev_t {
+  struct {
+    uint32_t send_xon;
+    uint32_t send_xoff;
+  } flow_conf;
+  struct {
+    uint32_t en;
+  } auto_baud;
+  struct {
+    uint32_t min_cnt;
+  } lowpulse;
+  struct {
+    uint32_t min_cnt;
+  } highpulse;
+  struct {
+    uint32_t rx_idle_thrhd;
+  } idle_conf;
+  struct {
+    uint32_t txfifo_cnt;
+    uint32_t st_utx_out;
+  } status;
+};
+
+extern uart_dev_t UART0;
+extern uart_dev_t UART1;
+extern uart_dev_t UART2;
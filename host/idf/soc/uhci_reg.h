@@ -0,0 +1,14 @@
+/// Host shim for soc/uhci_reg.h
+///
+/// \file   uhci_reg.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#define UHCI_IN_DONE_INT_ENA (1u << 4u)
+#define UHCI_IN_SUC_EOF_INT_ENA (1u << 5u)
+#define UHCI_IN_DSCR_ERR_INT_ENA (1u << 9u)
+#define UHCI_IN_DSCR_ERR_INT_ST (1u << 9u)
+#define UHCI_OUT_TOTAL_EOF_INT_ENA (1u << 13u)
+#define UHCI_INLINK_ADDR_V 0x000FFFFFu
@@ -0,0 +1,89 @@
+/// Host shim for soc/uhci_struct.h
+///
+/// Only the registers used by the UART DMA backend exist, volatile like on the
+/// target. Nothing on the host drives them, main/uart_dma.cpp only gets
+/// compiled against them.
+///
+/// \file   uhci_struct.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstdint>
+
+typedef volatile struct uhci_dev_s {
+  union {
+    struct {
+      uint32_t in_rst : 1;
+      uint32_t out_rst : 1;
+      uint32_t ahbm_fifo_rst : 1;
+      uint32_t ahbm_rst : 1;
+      uint32_t in_loop_test : 1;
+      uint32_t out_loop_test : 1;
+      uint32_t out_auto_wrback : 1;
+      uint32_t out_no_restart_clr : 1;
+      uint32_t out_eof_mode : 1;
+      uint32_t uart0_ce : 1;
+      uint32_t uart1_ce : 1;
+      uint32_t uart2_ce : 1;
+      uint32_t outdscr_burst_en : 1;
+      uint32_t indscr_burst_en : 1;
+      uint32_t out_data_burst_en : 1;
+      uint32_t mem_trans_en : 1;
+      uint32_t seper_en : 1;
+      uint32_t head_en : 1;
+      uint32_t crc_rec_en : 1;
+      uint32_t uart_idle_eof_en : 1;
+      uint32_t len_eof_en : 1;
+      uint32_t encode_crc_en : 1;
+      uint32_t clk_en : 1;
+      uint32_t uart_rx_brk_eof_en : 1;
+      uint32_t reserved24 : 8;
+    };
+    uint32_t val;
+  } conf0;
+  union {
+    uint32_t val;
+  } int_raw, int_st, int_ena, int_clr;
+  union {
+    struct {
+      uint32_t addr : 20;
+      uint32_t reserved20 : 8;
+      uint32_t stop : 1;
+      uint32_t start : 1;
+      uint32_t restart : 1;
+      uint32_t park : 1;
+    };
+    uint32_t val;
+  } dma_out_link, dma_in_link;
+  union {
+    struct {
+      uint32_t check_sum_en : 1;
+      uint32_t check_seq_en : 1;
+      uint32_t crc_disable : 1;
+      uint32_t save_head : 1;
+      uint32_t tx_check_sum_re : 1;
+      uint32_t tx_ack_num_re : 1;
+      uint32_t check_owner : 1;
+      uint32_t wait_sw_start : 1;
+      uint32_t sw_start : 1;
+      uint32_t dma_infifo_full_thrs : 12;
+      uint32_t reserved21 : 11;
+    };
+    uint32_t val;
+  } conf1;
+  union {
+    struct {
+      uint32_t thrs : 13;
+      uint32_t reserved13 : 19;
+    };
+    uint32_t val;
+  } pkt_thres;
+  union {
+    uint32_t val;
+  } escape_conf;
+} uhci_dev_t;
+
+extern uhci_dev_t UHCI0;
+extern uhci_dev_t UHCI1;
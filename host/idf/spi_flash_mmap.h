@@ -0,0 +1,7 @@
+/// Host shim for spi_flash_mmap.h
+///
+/// \file   spi_flash_mmap.h
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
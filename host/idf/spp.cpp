@@ -0,0 +1,643 @@
+/// Host shim for Bluedroid and SPP
+///
+/// All callbacks run on a single "btc" thread in order of their due time, like
+/// the Bluedroid BTC task does. A callback which blocks therefore delays every
+/// other event. The radio is a virtual link which loops writes back to the
+/// registered callback. It transmits one write after the other, frames are
+/// delivered as separate ESP_SPP_DATA_IND_EVT. Dropping the connection loses
+/// whatever is still on the air, a virtual master reconnects to the server
+/// after reconnect_time. A master (e.g. a hub) may open several connections,
+/// each one loops back to itself and all of them share the air. A poll interval
+/// slower than the default delays every write to the next poll, a new one
+/// takes effect at the next poll of the old one.
+///
+/// Paired with another host bridge through a Unix socket the link carries
+/// writes to that bridge instead. The master opens and drops connections on
+/// both sides, frames get delivered at the time the sender put them on its air
+/// plus the latency. Both processes share the steady clock.
+///
+/// \file   spp.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_bt.h>
+#include <esp_bt_device.h>
+#include <esp_bt_main.h>
+#include <esp_gap_bt_api.h>
+#include <esp_spp_api.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "host.hpp"
+
+using namespace std::chrono;
+
+namespace {
+
+/// Handle of the first SPP connection
+constexpr uint32_t spp_handle{0x81u};
+
+/// Maximum number of connections (piconet limit)
+constexpr size_t max_connections{7u};
+
+/// Server channel number the virtual peer announces
+constexpr uint8_t spp_scn{1u};
+
+/// Time connection setup takes (SDP, paging, RFCOMM)
+constexpr auto connect_time{milliseconds{50}};
+
+/// Time the virtual master takes to reconnect to the server
+constexpr auto reconnect_time{milliseconds{200}};
+
+/// Time paired bridges wait for each other to start
+constexpr auto pair_timeout{milliseconds{10'000}};
+
+struct Event {
+  steady_clock::time_point due;
+  uint64_t seq;
+  std::function<void()> f;
+
+  bool operator>(Event const& rhs) const {
+    return due != rhs.due ? due > rhs.due : seq > rhs.seq;
+  }
+};
+
+struct Write {
+  steady_clock::time_point departure;
+  size_t len;
+};
+
+/// Message between paired bridges
+struct Message {
+  enum : uint8_t { Open, Close, Data } type;
+  uint8_t index;    ///< Connection index
+  uint16_t len;     ///< Length of the RFCOMM frame which follows
+  int64_t due_ns;   ///< Delivery time on the steady clock
+};
+
+std::mutex mutex;
+std::condition_variable cv;
+std::priority_queue<Event, std::vector<Event>, std::greater<>> events;
+uint64_t seq{};
+esp_spp_cb_t cb{nullptr};
+esp_bt_gap_cb_t gap_cb{nullptr};
+host_link_config link_config{};
+uint32_t poll_interval{ESP_BT_GAP_TPOLL_DFT};
+
+/// State of a connection, guarded by mutex
+struct Connection {
+  std::deque<Write> in_flight;
+  size_t queued{};
+  bool congested{};
+  bool connected{};
+  bool opened{};          ///< Opened at least once
+  uint32_t generation{};  ///< Connections dropped so far
+};
+
+// Link state, guarded by mutex
+std::array<Connection, max_connections> connections;
+bool server{};
+steady_clock::time_point air_free{};
+bool paired{};
+
+/// Socket to the paired bridge, set once before the bridge starts
+int pair_fd{-1};
+std::mutex pair_mutex;
+
+/// Connection a handle refers to
+///
+/// \return Index or max_connections if the handle is invalid
+size_t index_of(uint32_t handle) {
+  auto const i{static_cast<size_t>(handle - spp_handle)};
+  return i < max_connections ? i : max_connections;
+}
+
+/// Schedule f on the BTC thread
+void post(steady_clock::time_point due, std::function<void()> f) {
+  std::lock_guard lock{mutex};
+  events.push({due, seq++, std::move(f)});
+  cv.notify_all();
+}
+
+/// Schedule a callback on the BTC thread
+void post(steady_clock::time_point due,
+          esp_spp_cb_event_t event,
+          esp_spp_cb_param_t const& param) {
+  post(due, [event, p = param]() mutable {
+    if (cb) cb(event, &p);
+  });
+}
+
+/// BTC task, runs on PRO_CPU like Bluedroid does
+void btc_task(void*) {
+  for (;;) {
+    std::unique_lock lock{mutex};
+    cv.wait(lock, [] { return !events.empty(); });
+    auto const due{events.top().due};
+    if (steady_clock::now() < due) {
+      cv.wait_until(lock, due);
+      continue;
+    }
+    auto f{std::move(const_cast<Event&>(events.top()).f)};
+    events.pop();
+    lock.unlock();
+    f();
+  }
+}
+
+/// Next poll of the link at or after t, guarded by mutex
+///
+/// Polls faster than the default don't hold writes back.
+steady_clock::time_point next_poll(steady_clock::time_point t) {
+  if (poll_interval <= ESP_BT_GAP_TPOLL_DFT) return t;
+  microseconds const interval{poll_interval * 625u};
+  auto const since{duration_cast<microseconds>(t.time_since_epoch()) %
+                   interval};
+  return since.count() ? t + (interval - since) : t;
+}
+
+/// Remove writes which left the air before t from the in-flight list
+void prune(Connection& c, steady_clock::time_point t) {
+  while (!empty(c.in_flight) && c.in_flight.front().departure <= t) {
+    c.queued -= c.in_flight.front().len;
+    c.in_flight.pop_front();
+  }
+}
+
+/// Air time of a single RFCOMM frame
+microseconds frame_time(size_t len) {
+  auto const bytes{len + link_config.frame_overhead};
+  auto const packets{(bytes + link_config.packet_payload - 1) /
+                     link_config.packet_payload};
+  return microseconds{packets * link_config.packet_us};
+}
+
+/// Send a message to the paired bridge, guarded by pair_mutex
+///
+/// \param  type  Message type
+/// \param  i     Connection index
+/// \param  due   Delivery time
+/// \param  data  Frame
+void transmit_locked(decltype(Message::type) type,
+                     size_t i,
+                     steady_clock::time_point due = {},
+                     std::vector<uint8_t> const& data = {}) {
+  Message const m{
+    type,
+    static_cast<uint8_t>(i),
+    static_cast<uint16_t>(size(data)),
+    duration_cast<nanoseconds>(due.time_since_epoch()).count()};
+  for (auto const& [p, len] :
+       {std::pair{reinterpret_cast<uint8_t const*>(&m), sizeof(m)},
+        std::pair{data.data(), size(data)}})
+    for (size_t j{}; j < len;) {
+      auto const n{send(pair_fd, p + j, len - j, MSG_NOSIGNAL)};
+      if (n <= 0) return;
+      j += static_cast<size_t>(n);
+    }
+}
+
+/// Send a message to the paired bridge
+void transmit(decltype(Message::type) type,
+              size_t i,
+              steady_clock::time_point due = {}) {
+  std::lock_guard lock{pair_mutex};
+  transmit_locked(type, i, due);
+}
+
+/// Read exactly len bytes from the paired bridge
+bool receive(void* data, size_t len) {
+  for (size_t j{}; j < len;) {
+    auto const n{read(pair_fd, static_cast<uint8_t*>(data) + j, len - j)};
+    if (n <= 0) return false;
+    j += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+/// Connection opened, report it the same way the peer would
+///
+/// \param  event ESP_SPP_OPEN_EVT or ESP_SPP_SRV_OPEN_EVT
+/// \param  i     Connection index
+/// \param  bda   BT device address of the peer
+/// \param  due   Time both sides report it
+void open(esp_spp_cb_event_t event,
+          size_t i,
+          uint8_t const* bda,
+          steady_clock::time_point due) {
+  {
+    std::lock_guard lock{mutex};
+    connections[i].connected = true;
+  }
+  auto const handle{spp_handle + static_cast<uint32_t>(i)};
+  esp_spp_cb_param_t param{};
+  if (event == ESP_SPP_OPEN_EVT) {
+    param.open.status = ESP_SPP_SUCCESS;
+    param.open.handle = handle;
+    std::memcpy(param.open.rem_bda, bda, sizeof(esp_bd_addr_t));
+  } else {
+    param.srv_open.status = ESP_SPP_SUCCESS;
+    param.srv_open.handle = handle;
+    std::memcpy(param.srv_open.rem_bda, bda, sizeof(esp_bd_addr_t));
+  }
+  post(due, [event, param, i]() mutable {
+    if (cb) cb(event, &param);
+    std::lock_guard lock{mutex};
+    connections[i].opened = true;
+    cv.notify_all();
+  });
+}
+
+/// Open a connection of the virtual master to the server
+///
+/// The virtual master has the address the host GAP picks for the peer of a
+/// slave.
+///
+/// \param  i   Connection index
+/// \param  due Time both sides report it, a paired master's frames arrive after
+///             it
+void open_server(size_t i,
+                 steady_clock::time_point due = steady_clock::now() +
+                                                connect_time) {
+  esp_bd_addr_t bda;
+  std::memcpy(bda, esp_bt_dev_get_address(), sizeof(bda));
+  ++bda[ESP_BD_ADDR_LEN - 1];
+  open(ESP_SPP_SRV_OPEN_EVT, i, bda, due);
+}
+
+/// Check whether an event belongs to a connection which got dropped
+bool stale(size_t i, uint32_t gen) {
+  std::lock_guard lock{mutex};
+  return gen != connections[i].generation;
+}
+
+/// Schedule delivery of a RFCOMM frame, guarded by mutex
+///
+/// \param  i     Connection index
+/// \param  gen   Generation of the connection
+/// \param  due   Delivery time
+/// \param  data  Frame
+void deliver(size_t i,
+             uint32_t gen,
+             steady_clock::time_point due,
+             std::vector<uint8_t> data) {
+  events.push({due, seq++, [i, gen, data = std::move(data)]() mutable {
+                 if (!cb || stale(i, gen)) return;
+                 esp_spp_cb_param_t param{};
+                 param.data_ind.status = ESP_SPP_SUCCESS;
+                 param.data_ind.handle = spp_handle + static_cast<uint32_t>(i);
+                 param.data_ind.len = static_cast<uint16_t>(size(data));
+                 param.data_ind.data = data.data();
+                 cb(ESP_SPP_DATA_IND_EVT, &param);
+               }});
+}
+
+/// Drop a connection
+///
+/// \param  i     Connection index
+/// \param  tell  Tell the paired bridge
+void drop(size_t i, bool tell = true) {
+  {
+    std::lock_guard lock{mutex};
+    auto& c{connections[i]};
+    if (!c.connected) return;
+    c.connected = false;
+    ++c.generation;
+    c.in_flight.clear();
+    c.queued = 0u;
+    c.congested = false;
+  }
+
+  // The paired bridge learns about it before a reconnect can open the next one
+  if (pair_fd >= 0 && tell) transmit(Message::Close, i);
+  esp_spp_cb_param_t param{};
+  param.close.status = ESP_SPP_SUCCESS;
+  param.close.handle = spp_handle + static_cast<uint32_t>(i);
+  post(steady_clock::now(), ESP_SPP_CLOSE_EVT, param);
+  if (pair_fd >= 0) return;
+  if (server)
+    post(steady_clock::now() + reconnect_time, [i] {
+      if (std::lock_guard lock{mutex}; !server) return;
+      open_server(i);
+    });
+}
+
+/// Take messages of the paired bridge until it's gone
+void pair_task() {
+  for (Message m; receive(&m, sizeof(m));) {
+    std::vector<uint8_t> data(m.len);
+    if (!receive(data.data(), size(data)) || m.index >= max_connections)
+      break;
+    size_t const i{m.index};
+    switch (m.type) {
+      case Message::Open:
+        open_server(i, steady_clock::time_point{nanoseconds{m.due_ns}});
+        break;
+      case Message::Close: drop(i, false); break;
+      case Message::Data: {
+        std::lock_guard lock{mutex};
+        auto const& c{connections[i]};
+        if (!c.connected) break;
+        deliver(i,
+                c.generation,
+                steady_clock::time_point{nanoseconds{m.due_ns}},
+                std::move(data));
+        cv.notify_all();
+        break;
+      }
+    }
+  }
+
+  // Paired bridge is gone, so are its connections
+  {
+    std::lock_guard lock{mutex};
+    paired = false;
+    cv.notify_all();
+  }
+  for (size_t i{}; i < max_connections; ++i) drop(i, false);
+}
+
+}  // namespace
+
+void host_spp_drop() {
+  for (size_t i{}; i < max_connections; ++i) drop(i);
+}
+
+bool host_spp_pair(char const* path, bool server_side) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1u);
+  auto const sa{reinterpret_cast<sockaddr const*>(&addr)};
+
+  // Server side waits for the master, which might not run yet
+  if (server_side) {
+    auto const fd{socket(AF_UNIX, SOCK_STREAM, 0)};
+    unlink(path);
+    pollfd pfd{fd, POLLIN, 0};
+    if (fd >= 0 && !bind(fd, sa, sizeof(addr)) && !listen(fd, 1) &&
+        poll(&pfd, 1, pair_timeout.count()) > 0)
+      pair_fd = accept(fd, nullptr, nullptr);
+    if (fd >= 0) close(fd);
+    unlink(path);
+  }
+
+  // Master retries until the server side listens
+  else
+    for (auto const start{steady_clock::now()};
+         pair_fd < 0 && steady_clock::now() - start < pair_timeout;) {
+      auto const fd{socket(AF_UNIX, SOCK_STREAM, 0)};
+      if (fd < 0) break;
+      if (!connect(fd, sa, sizeof(addr))) pair_fd = fd;
+      else {
+        close(fd);
+        std::this_thread::sleep_for(milliseconds{50});
+      }
+    }
+
+  if (pair_fd < 0) return false;
+  paired = true;
+  std::thread{pair_task}.detach();
+  return true;
+}
+
+void host_spp_wait_unpaired() {
+  std::unique_lock lock{mutex};
+  cv.wait(lock, [] { return !paired; });
+}
+
+void host_spp_set_link(host_link_config const& config) {
+  std::lock_guard lock{mutex};
+  link_config = config;
+}
+
+void host_spp_wait_open(size_t count) {
+  std::unique_lock lock{mutex};
+  cv.wait(lock, [count] {
+    return static_cast<size_t>(std::count_if(
+             begin(connections),
+             end(connections),
+             [](Connection const& c) { return c.opened; })) >= count;
+  });
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t) { return ESP_OK; }
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t*) {
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t) { return ESP_OK; }
+
+esp_err_t esp_bluedroid_init() { return ESP_OK; }
+
+uint8_t const* esp_bt_dev_get_address() {
+  static constexpr esp_bd_addr_t own{0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+  return own;
+}
+
+esp_err_t esp_bt_dev_set_device_name(char const*) { return ESP_OK; }
+
+esp_err_t esp_bluedroid_enable() {
+  xTaskCreatePinnedToCore(
+    &btc_task, "btc", 4096, nullptr, 19, nullptr, PRO_CPU_NUM);
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_register_callback(esp_spp_cb_t callback) {
+  cb = callback;
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_init(esp_spp_mode_t mode) {
+  if (mode != ESP_SPP_MODE_CB) return ESP_ERR_NOT_SUPPORTED;
+  esp_spp_cb_param_t param{};
+  param.init.status = ESP_SPP_SUCCESS;
+  post(steady_clock::now(), ESP_SPP_INIT_EVT, param);
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_deinit() {
+  {
+    std::lock_guard lock{mutex};
+    server = false;
+  }
+  for (size_t i{}; i < max_connections; ++i) drop(i);
+  esp_spp_cb_param_t param{};
+  param.init.status = ESP_SPP_SUCCESS;
+  post(steady_clock::now(), ESP_SPP_UNINIT_EVT, param);
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_start_discovery(esp_bd_addr_t) {
+  esp_spp_cb_param_t param{};
+  param.disc_comp.status = ESP_SPP_SUCCESS;
+  param.disc_comp.scn_num = 1u;
+  param.disc_comp.scn[0] = spp_scn;
+  param.disc_comp.service_name[0] = link_config.service_name;
+  post(steady_clock::now() + connect_time, ESP_SPP_DISCOVERY_COMP_EVT, param);
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_connect(esp_spp_sec_t,
+                          esp_spp_role_t,
+                          uint8_t remote_scn,
+                          esp_bd_addr_t peer_bd_addr) {
+  if (remote_scn != spp_scn) return ESP_FAIL;
+
+  // Take the first connection which isn't in use
+  size_t i{};
+  {
+    std::lock_guard lock{mutex};
+    if (pair_fd >= 0 && !paired) return ESP_FAIL;
+    while (i < max_connections && connections[i].connected) ++i;
+  }
+  if (i == max_connections) return ESP_FAIL;
+  auto const due{steady_clock::now() + connect_time};
+  if (pair_fd >= 0) transmit(Message::Open, i, due);
+
+  esp_spp_cb_param_t param{};
+  param.cl_init.status = ESP_SPP_SUCCESS;
+  param.cl_init.handle = spp_handle + static_cast<uint32_t>(i);
+  post(steady_clock::now(), ESP_SPP_CL_INIT_EVT, param);
+  open(ESP_SPP_OPEN_EVT, i, peer_bd_addr, due);
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_disconnect(uint32_t handle) {
+  auto const i{index_of(handle)};
+  if (i == max_connections) return ESP_FAIL;
+  drop(i);
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_start_srv(esp_spp_sec_t,
+                            esp_spp_role_t,
+                            uint8_t,
+                            char const*) {
+  esp_spp_cb_param_t param{};
+  param.start.status = ESP_SPP_SUCCESS;
+  post(steady_clock::now(), ESP_SPP_START_EVT, param);
+  {
+    std::lock_guard lock{mutex};
+    server = true;
+  }
+  // The virtual peer connects right away, a paired master once it's ready
+  if (pair_fd < 0) open_server(0u);
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_write(uint32_t handle, int len, uint8_t* p_data) {
+  auto const i{index_of(handle)};
+  if (i == max_connections || len <= 0 || !p_data) return ESP_ERR_INVALID_ARG;
+
+  std::unique_lock lock{mutex};
+  auto& c{connections[i]};
+  if (!c.connected) return ESP_FAIL;
+  auto const now{steady_clock::now()};
+  prune(c, now);
+  if (c.congested) return ESP_FAIL;
+
+  // Split into frames and put them on the air one after the other, frames to
+  // a paired bridge get sent once the lock is released
+  auto const gen{c.generation};
+  air_free = std::max(air_free, next_poll(now));
+  std::vector<std::pair<steady_clock::time_point, std::vector<uint8_t>>>
+    frames;
+  for (int j{}; j < len; j += link_config.mtu) {
+    auto const frame_len{std::min<int>(link_config.mtu, len - j)};
+    air_free += frame_time(static_cast<size_t>(frame_len));
+    auto const due{air_free + microseconds{link_config.latency_us}};
+    std::vector<uint8_t> data(p_data + j, p_data + j + frame_len);
+    if (pair_fd >= 0) frames.emplace_back(due, std::move(data));
+    else deliver(i, gen, due, std::move(data));
+  }
+  auto const departure{air_free};
+  c.in_flight.push_back({departure, static_cast<size_t>(len)});
+  c.queued += static_cast<size_t>(len);
+
+  // Congested as long as too much data waits for the air
+  if (c.queued > link_config.window) {
+    c.congested = true;
+    esp_spp_cb_param_t param{};
+    param.cong.status = ESP_SPP_SUCCESS;
+    param.cong.handle = handle;
+    param.cong.cong = true;
+    events.push({now, seq++, [i, gen, param]() mutable {
+                   if (cb && !stale(i, gen)) cb(ESP_SPP_CONG_EVT, &param);
+                 }});
+  }
+
+  // Write completes once the last frame left
+  events.push({departure, seq++, [i, gen, handle, len, departure] {
+                 std::unique_lock lock{mutex};
+                 auto& c{connections[i]};
+                 if (gen != c.generation) return;
+                 prune(c, departure);
+                 bool const cleared{c.congested &&
+                                    c.queued <= link_config.window / 2};
+                 if (cleared) c.congested = false;
+                 esp_spp_cb_param_t param{};
+                 param.write.status = ESP_SPP_SUCCESS;
+                 param.write.handle = handle;
+                 param.write.len = len;
+                 param.write.cong = c.congested;
+                 lock.unlock();
+                 if (!cb) return;
+                 cb(ESP_SPP_WRITE_EVT, &param);
+                 if (!cleared) return;
+                 param.cong.status = ESP_SPP_SUCCESS;
+                 param.cong.handle = handle;
+                 param.cong.cong = false;
+                 cb(ESP_SPP_CONG_EVT, &param);
+               }});
+  cv.notify_all();
+
+  // Frames must not overtake the close of the connection they belong to
+  std::unique_lock pair_lock{pair_mutex, std::defer_lock};
+  if (!empty(frames)) pair_lock.lock();
+  lock.unlock();
+  for (auto const& [due, data] : frames)
+    transmit_locked(Message::Data, i, due, data);
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_gap_register_callback(esp_bt_gap_cb_t callback) {
+  gap_cb = callback;
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_gap_set_qos(esp_bd_addr_t remote_bda, uint32_t t_poll) {
+  if (t_poll < ESP_BT_GAP_TPOLL_MIN || t_poll > ESP_BT_GAP_TPOLL_MAX)
+    return ESP_ERR_INVALID_ARG;
+  steady_clock::time_point due;
+  {
+    std::lock_guard lock{mutex};
+    due = next_poll(steady_clock::now());
+  }
+  esp_bt_gap_cb_param_t param{};
+  param.qos_cmpl.stat = ESP_BT_STATUS_SUCCESS;
+  std::memcpy(param.qos_cmpl.bda, remote_bda, sizeof(esp_bd_addr_t));
+  param.qos_cmpl.t_poll = t_poll;
+  post(due, [param]() mutable {
+    {
+      std::lock_guard lock{mutex};
+      poll_interval = param.qos_cmpl.t_poll;
+    }
+    if (gap_cb) gap_cb(ESP_BT_GAP_QOS_CMPL_EVT, &param);
+  });
+  return ESP_OK;
+}
@@ -0,0 +1,192 @@
+/// Host shim for system, logging and NVS functions
+///
+/// \file   system.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_bt_device.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_random.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+esp_log_level_t log_level{ESP_LOG_NONE};
+auto const boot{std::chrono::steady_clock::now()};
+
+// NVS lives in memory, every run starts with an empty flash
+std::mutex nvs_mutex;
+std::map<std::string, std::vector<uint8_t>> nvs;
+
+}  // namespace
+
+char const* esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now() - boot)
+    .count();
+}
+
+struct esp_timer {
+  esp_timer_create_args_t args;
+  std::atomic<uint32_t> generation;
+};
+
+esp_err_t esp_timer_create(esp_timer_create_args_t const* create_args,
+                           esp_timer_handle_t* out_handle) {
+  if (!create_args || !out_handle) return ESP_ERR_INVALID_ARG;
+  *out_handle = new esp_timer{.args = *create_args, .generation = {}};
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  auto const generation{++timer->generation};
+  std::thread{[timer, timeout_us, generation] {
+    std::this_thread::sleep_for(std::chrono::microseconds{timeout_us});
+    // Stopped or restarted meanwhile
+    if (timer->generation == generation)
+      timer->args.callback(timer->args.arg);
+  }}.detach();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  ++timer->generation;
+  return ESP_OK;
+}
+
+void esp_restart() {
+  std::fflush(stdout);
+  std::fprintf(stderr, "esp_restart\n");
+  std::_Exit(EXIT_FAILURE);
+}
+
+uint32_t esp_random() {
+  static std::random_device device;
+  return device();
+}
+
+uint32_t esp_get_free_heap_size() { return 0u; }
+
+uint32_t esp_get_minimum_free_heap_size() { return 0u; }
+
+esp_err_t esp_pm_configure(void const*) { return ESP_ERR_NOT_SUPPORTED; }
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t,
+                             int,
+                             char const*,
+                             esp_pm_lock_handle_t*) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_sleep_enable_uart_wakeup(int) { return ESP_ERR_NOT_SUPPORTED; }
+
+void esp_log_level_set(char const*, esp_log_level_t level) {
+  log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level,
+                   char const* tag,
+                   char const* format,
+                   ...) {
+  if (level > log_level) return;
+  std::fprintf(stderr, "%s: ", tag);
+  va_list args;
+  va_start(args, format);
+  std::vfprintf(stderr, format, args);
+  va_end(args);
+  std::fputc('\n', stderr);
+}
+
+void esp_log_buffer_hex(char const* tag, void const* buffer, uint16_t len) {
+  if (ESP_LOG_INFO > log_level) return;
+  std::fprintf(stderr, "%s:", tag);
+  for (auto i{0u}; i < len; ++i)
+    std::fprintf(stderr, " %02x", static_cast<uint8_t const*>(buffer)[i]);
+  std::fputc('\n', stderr);
+}
+
+esp_err_t nvs_flash_init() { return ESP_OK; }
+
+esp_err_t nvs_flash_erase() { return ESP_OK; }
+
+esp_err_t nvs_open(char const*, nvs_open_mode_t, nvs_handle_t* out_handle) {
+  *out_handle = 1u;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t,
+                       char const* key,
+                       void* out_value,
+                       size_t* length) {
+  std::scoped_lock lock{nvs_mutex};
+  auto const it{nvs.find(key)};
+  if (it == cend(nvs)) return ESP_ERR_NVS_NOT_FOUND;
+  if (*length < size(it->second)) return ESP_ERR_NVS_INVALID_LENGTH;
+  std::copy(cbegin(it->second),
+            cend(it->second),
+            static_cast<uint8_t*>(out_value));
+  *length = size(it->second);
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t,
+                       char const* key,
+                       void const* value,
+                       size_t length) {
+  std::scoped_lock lock{nvs_mutex};
+  auto const first{static_cast<uint8_t const*>(value)};
+  nvs[key].assign(first, first + length);
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t, char const* key) {
+  std::scoped_lock lock{nvs_mutex};
+  return nvs.erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t) { return ESP_OK; }
+
+void nvs_close(nvs_handle_t) {}
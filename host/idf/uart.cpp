@@ -0,0 +1,311 @@
+/// Host shim for the UART driver
+///
+/// A driver thread per port reads the slave side of a pseudo-terminal into the
+/// RX buffer. Like the RX interrupt it raises UART_DATA events once the
+/// FIFO full threshold is reached and when the line stays idle for the RX
+/// timeout. Writes are paced at the configured baud rate once more than the TX
+/// buffer is in flight, just like uart_write_bytes blocks when its ring buffer
+/// is full.
+///
+/// \file   uart.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <driver/uart.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <soc/uart_struct.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "host.hpp"
+
+using namespace std::chrono;
+
+uart_dev_t UART0{};
+uart_dev_t UART1{};
+uart_dev_t UART2{};
+
+namespace {
+
+/// UART clock the auto baud counters run at
+constexpr uint32_t apb_clk_freq{80'000'000};
+
+/// Bits per character on the line (start, 8 data, stop)
+constexpr int bits_per_char{10};
+
+/// Hardware RX FIFO size
+constexpr size_t rx_fifo_size{128u};
+
+struct Port {
+  int master{-1};
+  int slave{-1};
+  std::atomic<int> baud_rate{115200};
+  std::atomic<int> rx_full_thresh{120};
+  std::atomic<int> rx_timeout{10};
+  std::atomic<bool> rts{true};
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<uint8_t> rx;
+  size_t rx_buffer_size{};
+  QueueHandle_t events{nullptr};
+
+  size_t tx_buffer_size{};
+  steady_clock::time_point tx_done{};
+};
+
+Port ports[UART_NUM_MAX];
+uart_dev_t* const devs[UART_NUM_MAX]{&UART0, &UART1, &UART2};
+
+/// Time it takes to shift len characters at baud_rate
+nanoseconds char_time(size_t len, int baud_rate) {
+  return nanoseconds{uint64_t{len} * bits_per_char * 1'000'000'000 /
+                     static_cast<uint64_t>(baud_rate)};
+}
+
+/// Post driver event, drop it if the queue is full like the ISR does
+void post(Port& port, uart_event_type_t type, size_t size, bool tout) {
+  if (!port.events) return;
+  uart_event_t const event{type, size, tout};
+  xQueueSend(port.events, &event, 0);
+}
+
+/// Driver thread, stands in for the RX interrupt
+void rx_task(Port* port) {
+  size_t pending{};
+  for (;;) {
+    // Wait for data, or for the RX timeout if data is pending
+    pollfd pfd{port->slave, POLLIN, 0};
+    auto const tout{char_time(static_cast<size_t>(port->rx_timeout.load()),
+                              port->baud_rate.load())};
+    timespec const ts{static_cast<time_t>(tout.count() / 1'000'000'000),
+                      static_cast<long>(tout.count() % 1'000'000'000)};
+    auto const ready{ppoll(&pfd, 1, pending ? &ts : nullptr, nullptr)};
+    if (ready < 0) return;
+
+    // Line idle for RX timeout
+    if (!ready) {
+      post(*port, UART_DATA, pending, true);
+      pending = 0u;
+      continue;
+    }
+
+    std::unique_lock lock{port->mutex};
+    if (size(port->rx) >= port->rx_buffer_size) {
+      // RX interrupts stay off until the buffer got read
+      post(*port, UART_BUFFER_FULL, pending, false);
+      pending = 0u;
+      port->cv.wait(
+        lock, [port] { return size(port->rx) < port->rx_buffer_size; });
+    }
+    uint8_t buf[rx_fifo_size];
+    auto const n{
+      read(port->slave,
+           buf,
+           std::min(sizeof(buf), port->rx_buffer_size - size(port->rx)))};
+    if (n <= 0) return;
+    port->rx.insert(end(port->rx), buf, buf + n);
+    port->cv.notify_all();
+    lock.unlock();
+
+    // FIFO full threshold reached
+    pending += static_cast<size_t>(n);
+    if (pending >= static_cast<size_t>(port->rx_full_thresh.load())) {
+      post(*port, UART_DATA, pending, false);
+      pending = 0u;
+    }
+  }
+}
+
+}  // namespace
+
+void host_uart_set_line_baud(uart_port_t uart_num, int baud_rate) {
+  uint32_t const pulse{apb_clk_freq / static_cast<uint32_t>(baud_rate)};
+  devs[uart_num]->lowpulse.min_cnt = pulse;
+  devs[uart_num]->highpulse.min_cnt = pulse;
+}
+
+int host_uart_master_fd(uart_port_t uart_num) {
+  return ports[uart_num].master;
+}
+
+bool host_uart_rts(uart_port_t uart_num) { return ports[uart_num].rts; }
+
+esp_err_t uart_param_config(uart_port_t uart_num,
+                            uart_config_t const* uart_config) {
+  if (uart_num >= UART_NUM_MAX || !uart_config || uart_config->baud_rate <= 0)
+    return ESP_ERR_INVALID_ARG;
+  ports[uart_num].baud_rate = uart_config->baud_rate;
+  return ESP_OK;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate) {
+  if (uart_num >= UART_NUM_MAX || !baudrate) return ESP_ERR_INVALID_ARG;
+  ports[uart_num].baud_rate = static_cast<int>(baudrate);
+  return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t* baudrate) {
+  if (uart_num >= UART_NUM_MAX || !baudrate) return ESP_ERR_INVALID_ARG;
+  *baudrate = static_cast<uint32_t>(ports[uart_num].baud_rate.load());
+  return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int, int, int, int) {
+  return uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num,
+                              int rx_buffer_size,
+                              int tx_buffer_size,
+                              int queue_size,
+                              QueueHandle_t* uart_queue,
+                              int) {
+  if (uart_num >= UART_NUM_MAX || rx_buffer_size <= 0)
+    return ESP_ERR_INVALID_ARG;
+  auto& port{ports[uart_num]};
+  if (port.master >= 0) return ESP_FAIL;
+
+  char slave_name[64];
+  port.master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (port.master < 0 || grantpt(port.master) || unlockpt(port.master) ||
+      ptsname_r(port.master, slave_name, sizeof(slave_name)))
+    return ESP_FAIL;
+  port.slave = open(slave_name, O_RDWR | O_NOCTTY);
+  if (port.slave < 0) return ESP_FAIL;
+
+  // Raw mode, the line discipline must not touch binary data
+  termios tio{};
+  tcgetattr(port.slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(port.slave, TCSANOW, &tio);
+
+  port.rx_buffer_size = static_cast<size_t>(rx_buffer_size);
+  port.tx_buffer_size = static_cast<size_t>(tx_buffer_size);
+  if (queue_size && uart_queue) {
+    port.events = xQueueCreate(queue_size, sizeof(uart_event_t));
+    *uart_queue = port.events;
+  }
+  std::thread{rx_task, &port}.detach();
+
+  return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num,
+                    void* buf,
+                    uint32_t length,
+                    TickType_t ticks_to_wait) {
+  auto& port{ports[uart_num]};
+  if (port.slave < 0) return -1;
+
+  auto const until{steady_clock::now() +
+                   microseconds{uint64_t{ticks_to_wait} * 1'000'000 /
+                                configTICK_RATE_HZ}};
+  auto p{static_cast<uint8_t*>(buf)};
+  uint32_t len{};
+  std::unique_lock lock{port.mutex};
+  while (len < length) {
+    if (!port.cv.wait_until(lock, until, [&port] { return !empty(port.rx); }))
+      break;
+    auto const n{std::min<size_t>(size(port.rx), length - len)};
+    std::copy_n(begin(port.rx), n, p + len);
+    port.rx.erase(begin(port.rx), begin(port.rx) + static_cast<long>(n));
+    len += static_cast<uint32_t>(n);
+    port.cv.notify_all();
+  }
+  return static_cast<int>(len);
+}
+
+int uart_write_bytes(uart_port_t uart_num, void const* src, size_t size) {
+  auto& port{ports[uart_num]};
+  if (port.slave < 0) return -1;
+
+  auto p{static_cast<uint8_t const*>(src)};
+  for (size_t len{}; len < size;) {
+    auto const n{write(port.slave, p + len, size - len)};
+    if (n <= 0) return -1;
+    len += static_cast<size_t>(n);
+  }
+
+  // Block while more than the TX buffer is still waiting to be shifted out
+  auto const baud_rate{port.baud_rate.load()};
+  auto const now{steady_clock::now()};
+  port.tx_done = std::max(port.tx_done, now) + char_time(size, baud_rate);
+  auto const backlog{port.tx_done - now};
+  auto const buffered{char_time(port.tx_buffer_size, baud_rate)};
+  if (backlog > buffered) std::this_thread::sleep_for(backlog - buffered);
+
+  return static_cast<int>(size);
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t* size) {
+  auto& port{ports[uart_num]};
+  if (port.slave < 0 || !size) return ESP_FAIL;
+  std::lock_guard lock{port.mutex};
+  *size = std::size(port.rx);
+  return ESP_OK;
+}
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t uart_num, int threshold) {
+  if (uart_num >= UART_NUM_MAX || threshold <= 0 ||
+      static_cast<size_t>(threshold) >= rx_fifo_size)
+    return ESP_ERR_INVALID_ARG;
+  ports[uart_num].rx_full_thresh = threshold;
+  return ESP_OK;
+}
+
+esp_err_t uart_set_rx_timeout(uart_port_t uart_num, uint8_t tout_thresh) {
+  if (uart_num >= UART_NUM_MAX || tout_thresh > 126u)
+    return ESP_ERR_INVALID_ARG;
+  ports[uart_num].rx_timeout = tout_thresh;
+  return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num) {
+  auto& port{ports[uart_num]};
+  std::lock_guard lock{port.mutex};
+  port.rx.clear();
+  port.cv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t uart_set_rts(uart_port_t uart_num, int level) {
+  if (uart_num >= UART_NUM_MAX) return ESP_ERR_INVALID_ARG;
+  ports[uart_num].rts = level;
+  return ESP_OK;
+}
+
+esp_err_t uart_set_sw_flow_ctrl(uart_port_t uart_num, bool, uint8_t, uint8_t) {
+  return uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t
+uart_set_hw_flow_ctrl(uart_port_t uart_num, uart_hw_flowcontrol_t, uint8_t) {
+  return uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_wakeup_threshold(uart_port_t uart_num, int) {
+  return uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait) {
+  if (uart_num >= UART_NUM_MAX) return ESP_ERR_INVALID_ARG;
+  auto const until{steady_clock::now() +
+                   microseconds{uint64_t{ticks_to_wait} * 1'000'000 /
+                                configTICK_RATE_HZ}};
+  auto const done{ports[uart_num].tx_done};
+  if (done > until) {
+    std::this_thread::sleep_until(until);
+    return ESP_ERR_TIMEOUT;
+  }
+  std::this_thread::sleep_until(done);
+  return ESP_OK;
+}
@@ -0,0 +1,681 @@
+/// Host main
+///
+/// Runs the bridge against a pseudo-terminal and a virtual SPP link which loops
+/// back into the same bridge. Whatever gets written to the pseudo-terminal
+/// crosses the UART RX and BT TX half of the pipeline, comes back over the
+/// link and crosses the BT RX and UART TX half. That's the path a byte takes
+/// from one bridge to its peer.
+///
+/// Unless --interactive is given a pattern is pushed through the data port and
+/// throughput, latency and integrity are reported. --text replaces the pattern
+/// by log lines, which the link compresses well. --console pushes log lines
+/// through the console port at the same time, both ports share the link.
+/// --drop-ms drops the SPP connection periodically, the bridge has to
+/// reconnect without losing data. Interactive mode connects stdin and stdout
+/// to the data port instead. --selftest runs the PRBS self-test of the
+/// firmware over the link through AT+TEST. --baud-trace replays recorded auto
+/// baud pulse counters through the baud rate detector without running the
+/// bridge at all.
+/// --command escapes into command mode first, runs the given commands and goes
+/// back online before the pattern gets pushed.
+/// --pair pairs two bridges through a Unix socket instead of looping back. The
+/// slave (-s) runs until the master is gone and discards what arrives on its
+/// line, an echo would bring the command escape back. The master runs the
+/// self-test on both bridges, it has to come with the slave's report of the
+/// direction towards it. --idle-ms waits before the
+/// bench, long enough the links go idle and the first block shows the wake
+/// latency.
+///
+/// A hub build connects to bt_max_peers links which all loop back. The pattern
+/// is framed as broadcast blocks and the stream of every peer gets checked on
+/// its own. Blocks get written at a rate the merged streams fit onto the line.
+///
+/// \file   main.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_log.h>
+#include <getopt.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "baud_rate.hpp"
+#include "config.hpp"
+#include "host.hpp"
+#include "selftest.hpp"
+#include "telemetry.hpp"
+
+extern "C" void app_main();
+
+using namespace std::chrono;
+
+namespace {
+
+struct Options {
+  int baud_rate{uart_config_default.baud_rate};
+  size_t bytes{1u << 20u};
+  size_t block{256u};
+  uint32_t stall_ms{5000u};
+  bool interactive{};
+  bool telemetry{};
+  bool text{};
+  size_t console{};
+  size_t console_block{};
+  int console_baud{};
+  uint32_t selftest_s{};
+  uint32_t drop_ms{};
+  uint32_t idle_ms{};
+  char const* baud_trace{};
+  char const* commands{};
+  char const* pair{};
+  esp_spp_role_t role{ESP_SPP_ROLE_MASTER};
+  host_link_config link{};
+};
+
+/// Result of pushing a payload through a port
+struct Result {
+  size_t received{};
+  size_t errors{};
+  double elapsed{};
+  std::vector<int64_t> latencies;
+};
+
+/// Test payload, either a binary pattern or log lines
+std::vector<uint8_t> payload(size_t bytes, bool text) {
+  std::vector<uint8_t> retval(bytes);
+  if (!text) {
+    for (size_t i{}; i < size(retval); ++i)
+      retval[i] =
+        static_cast<uint8_t>(i ^ (i >> 8u) ^ (i >> 16u) ^ (i >> 24u));
+    return retval;
+  }
+
+  // Sensor readings which drift a little from line to line
+  uint32_t seed{1u};
+  auto const random{[&seed](uint32_t n) {
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 16u) % n;
+  }};
+  char line[96];
+  for (size_t i{}, t{}; i < size(retval); t += 10u + random(5u)) {
+    auto const n{std::snprintf(
+      line,
+      sizeof(line),
+      "I (%zu) sensor: temperature=%u.%u C humidity=%u %% pressure=%u Pa\n",
+      t,
+      20u + random(3u),
+      random(10u),
+      40u + random(5u),
+      101300u + random(50u))};
+    auto const len{std::min(static_cast<size_t>(n), size(retval) - i)};
+    std::memcpy(&retval[i], line, len);
+    i += len;
+  }
+  return retval;
+}
+
+/// Nanoseconds since epoch of the steady clock
+int64_t now_ns() {
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+    .count();
+}
+
+void usage(char const* name) {
+  std::printf(
+    "Usage: %s [options]\n"
+    "  -b, --baud N            line baud rate (default %d)\n"
+    "  -n, --bytes N           bytes to push through the bridge (default %zu)\n"
+    "  -k, --block N           bytes per write to the line (default %zu)\n"
+    "  -s, --slave             let the bridge be the SPP slave\n"
+    "  -i, --interactive       connect stdin/stdout to the line\n"
+    "  -t, --telemetry         print telemetry after the benchmark\n"
+    "      --text              push log lines instead of a binary pattern\n"
+    "      --console N         push N bytes of log lines through the console\n"
+    "                          port at the same time\n"
+    "      --console-block N   bytes per write to the console port (default\n"
+    "                          --block)\n"
+    "      --console-baud N    rate of the console port (default --baud)\n"
+    "      --selftest N        run the PRBS self-test for N seconds\n"
+    "  -v, --verbose           enable logging\n"
+    "      --mtu N             RFCOMM frame size (default %u)\n"
+    "      --latency-us N      one-way link latency (default %u)\n"
+    "      --packet-us N       air time per baseband packet (default %u)\n"
+    "      --packet-payload N  bytes per baseband packet (default %u)\n"
+    "      --window N          bytes in flight until congested (default %u)\n"
+    "      --peer-name NAME    SDP service name of the peer (default %s)\n"
+    "      --drop-ms N         drop the SPP connection every N ms\n"
+    "      --command CMDS      run AT commands separated by ; in command mode\n"
+    "                          before the bench\n"
+    "      --idle-ms N         wait N ms before the bench\n"
+    "      --pair PATH         pair with another bridge through a Unix socket\n"
+    "                          instead of looping back, e.g. for --selftest\n"
+    "      --baud-trace FILE   replay \"lowpulse highpulse\" lines through\n"
+    "                          the baud rate detector\n",
+    name,
+    Options{}.baud_rate,
+    Options{}.bytes,
+    Options{}.block,
+    Options{}.link.mtu,
+    Options{}.link.latency_us,
+    Options{}.link.packet_us,
+    Options{}.link.packet_payload,
+    Options{}.link.window,
+    bt_spp_server_name);
+}
+
+Options parse(int argc, char* argv[]) {
+  enum {
+    mtu = 0x100,
+    latency_us,
+    packet_us,
+    packet_payload,
+    window,
+    baud_trace,
+    selftest,
+    text,
+    peer_name,
+    drop_ms,
+    console,
+    console_block,
+    console_baud,
+    command,
+    idle_ms,
+    pair
+  };
+  static option const long_options[]{
+    {"baud", required_argument, nullptr, 'b'},
+    {"bytes", required_argument, nullptr, 'n'},
+    {"block", required_argument, nullptr, 'k'},
+    {"slave", no_argument, nullptr, 's'},
+    {"interactive", no_argument, nullptr, 'i'},
+    {"telemetry", no_argument, nullptr, 't'},
+    {"verbose", no_argument, nullptr, 'v'},
+    {"help", no_argument, nullptr, 'h'},
+    {"mtu", required_argument, nullptr, mtu},
+    {"latency-us", required_argument, nullptr, latency_us},
+    {"packet-us", required_argument, nullptr, packet_us},
+    {"packet-payload", required_argument, nullptr, packet_payload},
+    {"window", required_argument, nullptr, window},
+    {"baud-trace", required_argument, nullptr, baud_trace},
+    {"selftest", required_argument, nullptr, selftest},
+    {"text", no_argument, nullptr, text},
+    {"peer-name", required_argument, nullptr, peer_name},
+    {"drop-ms", required_argument, nullptr, drop_ms},
+    {"console", required_argument, nullptr, console},
+    {"console-block", required_argument, nullptr, console_block},
+    {"console-baud", required_argument, nullptr, console_baud},
+    {"command", required_argument, nullptr, command},
+    {"idle-ms", required_argument, nullptr, idle_ms},
+    {"pair", required_argument, nullptr, pair},
+    {nullptr, 0, nullptr, 0}};
+
+  Options opts;
+  opts.link.service_name = bt_spp_server_name;
+  for (int c;
+       (c = getopt_long(argc, argv, "b:n:k:sitvh", long_options, nullptr)) !=
+       -1;) {
+    auto const arg{optarg ? std::strtoull(optarg, nullptr, 0) : 0u};
+    switch (c) {
+      case 'b': opts.baud_rate = std::max(static_cast<int>(arg), 1); break;
+      case 'n': opts.bytes = arg; break;
+      case 'k': opts.block = std::max<size_t>(arg, 1u); break;
+      case 's': opts.role = ESP_SPP_ROLE_SLAVE; break;
+      case 'i': opts.interactive = true; break;
+      case 't': opts.telemetry = true; break;
+      case 'v': esp_log_level_set("*", ESP_LOG_VERBOSE); break;
+      case mtu: opts.link.mtu = static_cast<uint16_t>(arg); break;
+      case latency_us:
+        opts.link.latency_us = static_cast<uint32_t>(arg);
+        break;
+      case packet_us: opts.link.packet_us = static_cast<uint32_t>(arg); break;
+      case packet_payload:
+        opts.link.packet_payload = static_cast<uint16_t>(arg);
+        break;
+      case window: opts.link.window = static_cast<uint32_t>(arg); break;
+      case baud_trace: opts.baud_trace = optarg; break;
+      case selftest: opts.selftest_s = static_cast<uint32_t>(arg); break;
+      case text: opts.text = true; break;
+      case peer_name: opts.link.service_name = optarg; break;
+      case drop_ms: opts.drop_ms = static_cast<uint32_t>(arg); break;
+      case console: opts.console = arg; break;
+      case console_block:
+        opts.console_block = std::max<size_t>(arg, 1u);
+        break;
+      case console_baud:
+        opts.console_baud = std::max(static_cast<int>(arg), 1);
+        break;
+      case command: opts.commands = optarg; break;
+      case idle_ms: opts.idle_ms = static_cast<uint32_t>(arg); break;
+      case pair: opts.pair = optarg; break;
+      default:
+        usage(argv[0]);
+        std::exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+  }
+  return opts;
+}
+
+/// Write the payload to the line at baud rate and stamp every block
+void writer(Options const& opts,
+            std::vector<uint8_t> const& data,
+            uart_port_t num,
+            int fd,
+            std::vector<std::atomic<int64_t>>& sent) {
+  auto const start{steady_clock::now()};
+  for (size_t i{}; i < size(data); i += opts.block) {
+    auto const len{std::min(opts.block, size(data) - i)};
+
+    // Characters can't leave faster than the line allows
+    std::this_thread::sleep_until(
+      start + microseconds{uint64_t{i} * 10u * 1'000'000u /
+                           static_cast<uint64_t>(opts.baud_rate)});
+
+    // Honor RTS
+    while (!host_uart_rts(num))
+      std::this_thread::sleep_for(microseconds{100});
+
+    sent[i / opts.block].store(now_ns(), std::memory_order_relaxed);
+    for (size_t j{}; j < len;) {
+      auto const n{write(fd, &data[i + j], len - j)};
+      if (n <= 0) return;
+      j += static_cast<size_t>(n);
+    }
+  }
+}
+
+/// Drop the SPP connection periodically
+void dropper(uint32_t ms) {
+  for (;;) {
+    std::this_thread::sleep_for(milliseconds{ms});
+    host_spp_drop();
+  }
+}
+
+/// Copy everything from one file descriptor to another
+void pump(int from, int to) {
+  uint8_t buf[4096];
+  for (ssize_t n; (n = read(from, buf, sizeof(buf))) > 0;)
+    for (ssize_t i{}; i < n;) {
+      auto const m{write(to, buf + i, static_cast<size_t>(n - i))};
+      if (m <= 0) return;
+      i += m;
+    }
+}
+
+/// Replay recorded pulse counters through the baud rate detector
+int replay(Options const& opts) {
+  auto const f{std::fopen(opts.baud_trace, "r")};
+  if (!f) {
+    std::perror(opts.baud_trace);
+    return EXIT_FAILURE;
+  }
+
+  BaudRateDetector detector{opts.baud_rate};
+  size_t samples{};
+  size_t commits{};
+  char line[128];
+  while (std::fgets(line, sizeof(line), f)) {
+    unsigned long lowpulse, highpulse;
+    if (*line == '#' ||
+        std::sscanf(line, "%lu %lu", &lowpulse, &highpulse) != 2)
+      continue;
+    ++samples;
+    if (!detector(static_cast<uint32_t>(lowpulse),
+                  static_cast<uint32_t>(highpulse)))
+      continue;
+    ++commits;
+    std::printf("sample %zu: %d baud\n", samples, detector.baud_rate());
+  }
+  std::fclose(f);
+
+  std::printf("baud rate   %d\n", detector.baud_rate());
+  std::printf("samples     %zu\n", samples);
+  std::printf("commits     %zu\n", commits);
+  return EXIT_SUCCESS;
+}
+
+/// Read a reply of command mode
+///
+/// \param  timeout Time a read may take [ms]
+/// \return Reply or an empty string if none arrived in time
+std::string reply(int fd,
+                  int timeout = 2 * static_cast<int>(command_guard_time)) {
+  std::string retval;
+  auto const done{[&retval](char const* end) {
+    auto const n{std::strlen(end)};
+    return size(retval) >= n && !retval.compare(size(retval) - n, n, end);
+  }};
+  while (!done("OK\r\n") && !done("ERROR\r\n")) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout) <= 0)
+      return {};
+    char buf[256];
+    auto const n{read(fd, buf, sizeof(buf))};
+    if (n <= 0) return {};
+    retval.append(buf, static_cast<size_t>(n));
+  }
+  return retval;
+}
+
+/// Escape into command mode, run commands separated by ';' and go back online
+///
+/// The escape characters get bridged like any other data, unless a hub drops
+/// them they come back ahead of the first reply.
+int command(Options const& opts, int fd) {
+  auto const send{[fd](std::string const& s) {
+    return write(fd, data(s), size(s)) == static_cast<ssize_t>(size(s));
+  }};
+  auto const guard{milliseconds{command_guard_time * 3u / 2u}};
+
+  std::this_thread::sleep_for(guard);
+  send(std::string(command_escape_len, command_escape_char));
+  std::this_thread::sleep_for(guard);
+  if (auto const r{reply(fd)}; empty(r) || r.back() != '\n' ||
+                               r.find("ERROR") != std::string::npos) {
+    std::fprintf(stderr, "Command mode not entered\n");
+    return EXIT_FAILURE;
+  }
+
+  auto retval{EXIT_SUCCESS};
+  std::string const commands{opts.commands};
+  for (size_t i{}; i <= size(commands);) {
+    auto const j{std::min(commands.find(';', i), size(commands))};
+    auto const cmd{commands.substr(i, j - i)};
+    i = j + 1u;
+    if (empty(cmd)) continue;
+    send(cmd + "\r");
+    auto r{reply(fd)};
+
+    // AT+TEST goes online, command mode returns with the report
+    // plus the wait for the peer's report
+    if (!cmd.compare(0u, 8u, "AT+TEST=") && r == "OK\r\n")
+      r += reply(fd, (std::atoi(cmd.c_str() + 8) + 4) * 1000);
+    std::printf("%s\n%s", cmd.c_str(), r.c_str());
+    if (empty(r) || r.find("ERROR") != std::string::npos)
+      retval = EXIT_FAILURE;
+  }
+  send("ATO\r");
+  if (reply(fd) != "OK\r\n") retval = EXIT_FAILURE;
+  return retval;
+}
+
+/// Push data through a port and check what comes back
+Result measure(Options const& opts,
+               std::vector<uint8_t> const& data,
+               uart_port_t num,
+               int fd) {
+  auto const blocks{(size(data) + opts.block - 1u) / opts.block};
+  std::vector<std::atomic<int64_t>> sent(blocks);
+  Result retval;
+  retval.latencies.reserve(blocks);
+
+  auto const start{now_ns()};
+  std::thread writing{
+    writer, std::cref(opts), std::cref(data), num, fd, std::ref(sent)};
+
+  uint8_t buf[4096];
+  while (retval.received < size(data)) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(opts.stall_ms)) <= 0) break;
+    auto const n{read(fd, buf, sizeof(buf))};
+    if (n <= 0) break;
+    auto const t{now_ns()};
+    for (ssize_t j{}; j < n; ++j) {
+      retval.errors += buf[j] != data[retval.received];
+      // Last byte of a block completes it
+      if (++retval.received % opts.block == 0 ||
+          retval.received == size(data))
+        retval.latencies.push_back(
+          t - sent[(retval.received - 1u) / opts.block].load(
+                std::memory_order_relaxed));
+    }
+  }
+  retval.elapsed = static_cast<double>(now_ns() - start) / 1e9;
+  writing.detach();
+  return retval;
+}
+
+/// Broadcast the payload through a hub and check what every peer sends back
+void hub_measure(Options const& opts,
+                 std::vector<uint8_t> const& data,
+                 int fd,
+                 std::array<Result, bt_max_peers>& results) {
+  // Frame every block as broadcast
+  std::vector<uint8_t> framed;
+  for (size_t i{}; i < size(data); i += opts.block) {
+    auto const len{std::min(opts.block, size(data) - i)};
+    framed.insert(end(framed),
+                  {hub_frame_sync,
+                   hub_broadcast,
+                   static_cast<uint8_t>(len),
+                   static_cast<uint8_t>(len >> 8u)});
+    framed.insert(end(framed),
+                  begin(data) + static_cast<ptrdiff_t>(i),
+                  begin(data) + static_cast<ptrdiff_t>(i + len));
+  }
+  // Every peer sends the payload back, so the merged stream only fits onto the
+  // line if the payload takes up less than a peer's share (headers, drift)
+  auto framed_opts{opts};
+  framed_opts.block = opts.block + hub_header_size;
+  framed_opts.baud_rate =
+    std::max(opts.baud_rate / static_cast<int>(size(results) + 1u), 1);
+
+  auto const blocks{(size(data) + opts.block - 1u) / opts.block};
+  std::vector<std::atomic<int64_t>> sent(blocks);
+  auto const start{now_ns()};
+  std::thread writing{writer,
+                      std::cref(framed_opts),
+                      std::cref(framed),
+                      uart_ports[0u].num,
+                      fd,
+                      std::ref(sent)};
+
+  // Split what comes back into the streams of the peers
+  uint8_t header[hub_header_size];
+  size_t header_fill{}, peer{}, left{}, done{};
+  uint8_t buf[4096];
+  while (done < size(results)) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(opts.stall_ms)) <= 0) break;
+    auto const n{read(fd, buf, sizeof(buf))};
+    if (n <= 0) break;
+    auto const t{now_ns()};
+    for (ssize_t j{}; j < n; ++j) {
+      if (!left) {
+        if (!header_fill && buf[j] != hub_frame_sync) continue;
+        header[header_fill++] = buf[j];
+        if (header_fill < hub_header_size) continue;
+        header_fill = 0u;
+        peer = header[1u];
+        left = static_cast<size_t>(header[2u] | header[3u] << 8u);
+        continue;
+      }
+      --left;
+      if (peer >= size(results)) continue;
+      auto& r{results[peer]};
+      if (r.received == size(data)) continue;
+      r.errors += buf[j] != data[r.received];
+      if (++r.received % opts.block && r.received != size(data)) continue;
+      r.latencies.push_back(
+        t - sent[(r.received - 1u) / opts.block].load(
+              std::memory_order_relaxed));
+      if (r.received != size(data)) continue;
+      r.elapsed = static_cast<double>(t - start) / 1e9;
+      ++done;
+    }
+  }
+  for (auto& r : results)
+    if (r.received != size(data))
+      r.elapsed = static_cast<double>(now_ns() - start) / 1e9;
+  writing.detach();
+}
+
+/// Print a result
+void print(char const* prefix, Result& result, size_t bytes) {
+  auto& latencies{result.latencies};
+  std::sort(begin(latencies), end(latencies));
+  auto const percentile{[&](double p) {
+    if (empty(latencies)) return 0.0;
+    auto const i{
+      static_cast<size_t>(p * static_cast<double>(size(latencies) - 1u))};
+    return static_cast<double>(latencies[i]) / 1e6;
+  }};
+
+  std::printf("%sbytes       %zu/%zu\n", prefix, result.received, bytes);
+  std::printf("%serrors      %zu\n", prefix, result.errors);
+  std::printf("%stime        %.3f s\n", prefix, result.elapsed);
+  std::printf("%sthroughput  %.0f B/s\n",
+              prefix,
+              static_cast<double>(result.received) / result.elapsed);
+  std::printf(
+    "%slatency     min %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+    prefix,
+    percentile(0.0),
+    percentile(0.5),
+    percentile(0.99),
+    percentile(1.0));
+}
+
+/// Run the payload through the bridge and report the result
+int bench(Options const& opts, int fd) {
+  // Hub checks the stream of every peer
+  if constexpr (bt_hub) {
+    if (opts.block > 0xFFFFu) {
+      std::fprintf(stderr, "Block too large for hub framing\n");
+      return EXIT_FAILURE;
+    }
+    auto const data{payload(opts.bytes, opts.text)};
+    std::array<Result, bt_max_peers> results;
+    hub_measure(opts, data, fd, results);
+    auto retval{EXIT_SUCCESS};
+    for (size_t i{}; i < size(results); ++i) {
+      char prefix[16];
+      std::snprintf(prefix, sizeof(prefix), "peer%zu ", i);
+      print(prefix, results[i], opts.bytes);
+      if (results[i].received != opts.bytes || results[i].errors)
+        retval = EXIT_FAILURE;
+    }
+    return retval;
+  }
+
+  // Console port runs alongside the data port
+  Result console;
+  std::vector<uint8_t> console_data;
+  std::thread consoling;
+  auto console_opts{opts};
+  if (opts.console_block) console_opts.block = opts.console_block;
+  if (opts.console_baud) console_opts.baud_rate = opts.console_baud;
+  if (opts.console && size(uart_ports) < 2u) {
+    std::fprintf(stderr, "Console port not bridged (AOIHASHI_UART_CONSOLE)\n");
+    return EXIT_FAILURE;
+  }
+  if (opts.console) {
+    console_data = payload(opts.console, true);
+    auto const num{uart_ports.back().num};
+    consoling = std::thread{[&, num] {
+      console =
+        measure(console_opts, console_data, num, host_uart_master_fd(num));
+    }};
+  }
+
+  auto const data{payload(opts.bytes, opts.text)};
+  auto result{measure(opts, data, uart_ports[0u].num, fd)};
+  if (consoling.joinable()) consoling.join();
+
+  print("", result, opts.bytes);
+  if (opts.console) print("console ", console, opts.console);
+
+  return result.received == opts.bytes && !result.errors &&
+             console.received == opts.console && !console.errors
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto const opts{parse(argc, argv)};
+  if (opts.baud_trace) return replay(opts);
+
+  host_spp_set_link(opts.link);
+  host_gap_set_role(opts.role);
+  for (auto const& port : uart_ports)
+    host_uart_set_line_baud(port.num, opts.baud_rate);
+  bool const paired_slave{opts.pair && opts.role == ESP_SPP_ROLE_SLAVE};
+  if (opts.pair && !host_spp_pair(opts.pair, paired_slave)) {
+    std::fprintf(stderr, "No bridge to pair with at %s\n", opts.pair);
+    return EXIT_FAILURE;
+  }
+  app_main();
+
+  host_spp_wait_open(bt_max_peers);
+  auto const fd{host_uart_master_fd(uart_ports[0u].num)};
+  if (fd < 0) {
+    std::fprintf(stderr, "UART driver not installed\n");
+    return EXIT_FAILURE;
+  }
+
+  // Paired slave runs until the master is gone
+  if (paired_slave) {
+    std::thread{[fd] {
+      for (uint8_t buf[256]; read(fd, buf, sizeof(buf)) > 0;) {}
+    }}.detach();
+    host_spp_wait_unpaired();
+    std::_Exit(EXIT_SUCCESS);
+  }
+
+  if (opts.drop_ms) std::thread{dropper, opts.drop_ms}.detach();
+
+  if (opts.commands && command(opts, fd) != EXIT_SUCCESS) {
+    std::fflush(stdout);
+    std::_Exit(EXIT_FAILURE);
+  }
+
+  // Self-test through AT+TEST, the firmware prints the report
+  if (opts.selftest_s) {
+    auto const test{"AT+TEST=" + std::to_string(opts.selftest_s)};
+    auto test_opts{opts};
+    test_opts.commands = test.c_str();
+    command(test_opts, fd);
+    auto const passed{[](SelftestReport const& r) {
+      return r.rx_frames && !r.byte_errors && !r.lost && !r.duplicated;
+    }};
+    SelftestReport peer{};
+    auto const peer_reported{selftest_peer_report(peer)};
+    if (opts.telemetry) telemetry_print(telemetry_snapshot());
+    std::fflush(stdout);
+    std::_Exit(passed(selftest_report()) &&
+                   (!opts.pair || (peer_reported && passed(peer)))
+                 ? EXIT_SUCCESS
+                 : EXIT_FAILURE);
+  }
+
+  if (opts.interactive) {
+    std::thread{pump, fd, STDOUT_FILENO}.detach();
+    pump(STDIN_FILENO, fd);
+    // Give the bridge time to deliver what's left
+    std::this_thread::sleep_for(seconds{1});
+    std::_Exit(EXIT_SUCCESS);
+  }
+
+  std::this_thread::sleep_for(milliseconds{opts.idle_ms});
+  auto const before{telemetry_snapshot()};
+  auto const ret{bench(opts, fd)};
+  if (opts.telemetry) {
+    auto const after{telemetry_snapshot()};
+    telemetry_print(after);
+    telemetry_print_load(before, after);
+  }
+  std::fflush(stdout);
+  std::_Exit(ret);
+}
@@ -0,0 +1,111 @@
+/// UART DMA stand-in for the host build
+///
+/// There is no UHCI on the host. The stand-in sits on top of the UART shim and
+/// hands out data under the same conditions as the engine hands back a
+/// descriptor, once the line went idle for uart_rx_timeout characters or a
+/// frame worth of data arrived. Writes block until the data is on the
+/// line.
+///
+/// \file   uart_dma.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <driver/uart.h>
+#include <uart_dma.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <config.hpp>
+#include <settings.hpp>
+#include <thread>
+
+using namespace std::chrono;
+
+namespace {
+
+/// Bits per character on the line (start, 8 data, stop)
+constexpr uint64_t bits_per_char{10u};
+
+struct Engine {
+  QueueHandle_t events{nullptr};
+  std::atomic<size_t> frame_len{uart_chunk_size};
+};
+
+std::array<Engine, size(uart_ports)> engines;
+
+/// Time the line must stay idle to end a frame
+nanoseconds idle_time(uart_port_t num) {
+  uint32_t baud_rate{};
+  uart_get_baudrate(num, &baud_rate);
+  return nanoseconds{uart_rx_timeout * bits_per_char * 1'000'000'000 /
+                     std::max(baud_rate, 1u)};
+}
+
+}  // namespace
+
+void uart_dma_init(size_t i) {
+  auto const num{uart_ports[i].num};
+  uart_driver_install(num,
+                      static_cast<int>(uart_dma_rx_descs * uart_chunk_size),
+                      0,
+                      uart_event_queue_len,
+                      &engines[i].events,
+                      0);
+  uart_set_rx_full_threshold(num, uart_rx_full_thresh);
+  uart_set_rx_timeout(num, uart_rx_timeout);
+  uint32_t baud_rate{};
+  uart_get_baudrate(num, &baud_rate);
+  uart_dma_set_baud_rate(i, baud_rate);
+}
+
+void uart_dma_set_baud_rate(size_t i, uint32_t baud_rate) {
+  engines[i].frame_len =
+    uart_dma_frame_len(baud_rate, settings.aggregation_window);
+}
+
+int uart_dma_read(size_t i, uint8_t* data, size_t max, TickType_t ticks) {
+  auto const num{uart_ports[i].num};
+  auto& e{engines[i]};
+  size_t buffered{};
+  uart_get_buffered_data_len(num, &buffered);
+
+  // Wait for data unless uart_dma_wake ends the wait
+  while (!buffered) {
+    uart_event_t event;
+    if (!xQueueReceive(e.events, &event, ticks) ||
+        event.type == UART_EVENT_MAX)
+      return 0;
+    uart_get_buffered_data_len(num, &buffered);
+  }
+
+  // Wait for the end of the frame
+  for (size_t prev{}; buffered != prev && buffered < e.frame_len;) {
+    prev = buffered;
+    std::this_thread::sleep_for(idle_time(num));
+    uart_get_buffered_data_len(num, &buffered);
+  }
+
+  buffered = std::min(buffered, max);
+  return std::max(uart_read_bytes(num, data, buffered, 0), 0);
+}
+
+void uart_dma_wake(size_t i) {
+  uart_event_t event{};
+  event.type = UART_EVENT_MAX;
+  xQueueSend(engines[i].events, &event, 0u);
+}
+
+void uart_dma_write(size_t i, uint8_t const* data, size_t len) {
+  auto const num{uart_ports[i].num};
+  while (len) {
+    auto const n{uart_write_bytes(num, data, len)};
+    if (n <= 0) return;
+    data += n;
+    len -= static_cast<size_t>(n);
+  }
+}
+
+void uart_dma_wait_tx_done(size_t i) {
+  uart_wait_tx_done(uart_ports[i].num, portMAX_DELAY);
+}
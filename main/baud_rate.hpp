@@ -0,0 +1,123 @@
+/// Baud rate detection
+///
+/// The auto baud unit measures the shortest low and high pulse it saw since it
+/// got enabled. A single glitch therefore sticks until the counters get reset
+/// and would retune the UART right in the middle of a burst. The detector
+/// only commits a new rate once uart_baud_rate_samples consecutive
+/// measurements agree on it. Measurements within uart_baud_rate_hysteresis of
+/// the current rate count as the current rate.
+///
+/// The detector is plain state without any hardware access or locking, so
+/// recorded pulse traces can be replayed on the host.
+///
+/// \file   baud_rate.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "config.hpp"
+
+/// Clock the auto baud pulse counters run at
+constexpr uint32_t baud_rate_clk_freq{80'000'000u};
+
+/// Supported baud rates, sorted
+constexpr std::array supported_baud_rates{
+  300,     600,     1200,    2400,    4800,    9600,    14400,
+  19200,   38400,   57600,   115200,  128000,  153600,  230400,
+  256000,  460800,  500000,  921600,  1000000, 1500000, 2000000,
+  2500000, 3000000, 3500000, 4000000, 4500000, 5000000};
+
+/// Check if supported baud rates are sorted
+constexpr bool supported_baud_rates_sorted() {
+  for (size_t i{1u}; i < size(supported_baud_rates); ++i)
+    if (supported_baud_rates[i - 1u] >= supported_baud_rates[i]) return false;
+  return true;
+}
+static_assert(supported_baud_rates_sorted());
+
+/// Snap a measured baud rate to the nearest supported one
+///
+/// \param  baud_rate Measured baud rate
+/// \return Nearest supported baud rate
+constexpr int nearest_baud_rate(uint32_t baud_rate) {
+  // Binary search for the first rate not below baud_rate
+  size_t first{}, count{size(supported_baud_rates)};
+  while (count) {
+    auto const step{count / 2u};
+    if (static_cast<uint32_t>(supported_baud_rates[first + step]) < baud_rate) {
+      first += step + 1u;
+      count -= step + 1u;
+    } else count = step;
+  }
+
+  if (!first) return supported_baud_rates.front();
+  if (first == size(supported_baud_rates)) return supported_baud_rates.back();
+  auto const lo{static_cast<uint32_t>(supported_baud_rates[first - 1u])};
+  auto const hi{static_cast<uint32_t>(supported_baud_rates[first])};
+  return baud_rate - lo < hi - baud_rate ? supported_baud_rates[first - 1u]
+                                         : supported_baud_rates[first];
+}
+static_assert(nearest_baud_rate(0u) == 300);
+static_assert(nearest_baud_rate(118'000u) == 115200);
+static_assert(nearest_baud_rate(900'000u) == 921600);
+static_assert(nearest_baud_rate(10'000'000u) == 5000000);
+
+/// Baud rate detector
+class BaudRateDetector {
+public:
+  /// Counter value of a pulse width which hasn't been measured yet
+  static constexpr uint32_t invalid_pulse{0xFFFFFu};
+
+  constexpr explicit BaudRateDetector(int baud_rate) : baud_rate_{baud_rate} {}
+
+  /// Feed a measurement
+  ///
+  /// \param  lowpulse  Minimum low-pulse width
+  /// \param  highpulse Minimum high-pulse width
+  /// \return true if a new baud rate got committed
+  constexpr bool operator()(uint32_t lowpulse, uint32_t highpulse) {
+    // No edges since the counters got reset
+    if (!lowpulse || !highpulse || lowpulse >= invalid_pulse ||
+        highpulse >= invalid_pulse)
+      return false;
+
+    auto const measured{baud_rate_clk_freq / ((lowpulse + highpulse) / 2u)};
+
+    // Close enough to the current rate, drop any candidate
+    auto const delta{measured > static_cast<uint32_t>(baud_rate_)
+                       ? measured - static_cast<uint32_t>(baud_rate_)
+                       : static_cast<uint32_t>(baud_rate_) - measured};
+    if (uint64_t{delta} * 100u <=
+        uint64_t{static_cast<uint32_t>(baud_rate_)} *
+          uart_baud_rate_hysteresis) {
+      count_ = 0u;
+      return false;
+    }
+
+    // Count consecutive agreeing estimates
+    auto const estimate{nearest_baud_rate(measured)};
+    if (estimate == baud_rate_) {
+      count_ = 0u;
+      return false;
+    }
+    count_ = estimate == candidate_ ? count_ + 1u : 1u;
+    candidate_ = estimate;
+    if (count_ < uart_baud_rate_samples) return false;
+
+    baud_rate_ = candidate_;
+    count_ = 0u;
+    return true;
+  }
+
+  /// Currently committed baud rate
+  constexpr int baud_rate() const { return baud_rate_; }
+
+private:
+  int baud_rate_;
+  int candidate_{};
+  uint32_t count_{};
+};
@@ -14,50 +14,629 @@
 #include <esp_task_wdt.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bt.hpp>
 #include <bt_gap.hpp>
 #include <cstdint>
 #include <cstring>
+#include <utility>
 #include "config.hpp"
+#include "link.hpp"
+#include "power.hpp"
 #include "queue.hpp"
+#include "static_task.hpp"
+#include "telemetry.hpp"
+#include "uart.hpp"
 
-/// BT transmit task
+/// Connection to a peer
+struct Connection {
+  /// BT transmit task handle
+  TaskHandle_t task{nullptr};
+
+  /// Connection state
+  std::atomic<BtState> state{BtState::Idle};
+
+  /// Connection counter, odd while a connection is open
+  std::atomic<uint32_t> counter{};
+
+  /// Handle of the open connection, only changes while the counter is even
+  std::atomic<uint32_t> spp_handle{};
+
+  /// Connection bt_tx_task currently serves
+  uint32_t tx_counter{};
+
+  /// Bytes every port may still send in its current turn
+  std::array<uint32_t, size(uart_ports)> deficits{};
+
+  /// Port whose turn it is
+  size_t turn{};
+
+  /// Turn of the current port started
+  bool granted{};
+
+  /// Number of SPP writes which haven't completed yet
+  std::atomic<uint32_t> pending_writes{};
+
+  /// SPP congestion status
+  std::atomic<bool> congested{};
+
+  /// Data kept back until it fills a RFCOMM frame
+  std::array<uint8_t, bt_spp_mtu> segment{};
+  size_t segment_fill{};
+
+  /// Link is idle
+  bool idle{};
+
+  /// bt_tx_task waits for UART data without a timeout
+  std::atomic<bool> idle_wait{};
+};
+
+/// Connections of all peers, each one gets served by its own bt_tx_task
+static std::array<Connection, bt_max_peers> connections;
+
+/// Task names, the first peer keeps the name of a single peer build
+static constexpr char const* task_names[]{"bt_tx_task",
+                                          "bt_tx_task1",
+                                          "bt_tx_task2",
+                                          "bt_tx_task3",
+                                          "bt_tx_task4",
+                                          "bt_tx_task5",
+                                          "bt_tx_task6"};
+static_assert(bt_max_peers <= std::size(task_names));
+
+/// Tasks of all peers
+static std::array<StaticTask<task_placement.bt_tx.stack_size>, bt_max_peers>
+  tasks;
+
+static_assert(sizeof(connections) + sizeof(bt_channels) +
+                  sizeof(bt_priority_channels) + sizeof(tasks) <=
+                bt_dram_budget,
+              "BT exceeds its DRAM budget");
+
+/// Check whether the connection bt_tx_task serves is still open
+///
+/// \param  c Connection
+static bool alive(Connection const& c) {
+  return c.counter.load() == c.tx_counter;
+}
+
+/// Switch connection state
+///
+/// \param  c   Connection
+/// \param  to  New state
+static void set_state(Connection& c, BtState to) {
+  static constexpr char const* names[]{
+    "idle", "negotiating", "streaming", "reconnecting"};
+  if (c.state.exchange(to) != to)
+    ESP_LOGI(bt_tag,
+             "peer %u state %s",
+             static_cast<unsigned>(&c - data(connections)),
+             names[static_cast<size_t>(to)]);
+}
+
+/// Wait for an open connection and take its counter and handle
 ///
-/// \param  pvHandle  BT connection handle
-static void bt_tx_task(void* pvHandle) {
-  uint32_t const handle{(uint32_t const)pvHandle};
+/// Counter and handle are read like a sequence lock, a handle which got
+/// swapped meanwhile is never paired with the wrong counter.
+///
+/// \param  c Connection
+/// \return Handle of the open connection
+static uint32_t wait_for_connection(Connection& c) {
+  for (;;) {
+    while (!(c.counter.load() & 1u)) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    auto const counter{c.counter.load()};
+    auto const handle{c.spp_handle.load()};
+    if ((counter & 1u) && c.counter.load() == counter) {
+      c.tx_counter = counter;
+      return handle;
+    }
+  }
+}
 
+/// Write data to SPP
+///
+/// Blocks until the link isn't congested and less than
+/// bt_spp_max_pending_writes writes are in flight. The SPP callback wakes the
+/// task through a notification whenever either changes.
+///
+/// \param  c       Connection
+/// \param  handle  BT connection handle
+/// \param  len     Length of data
+/// \param  data    Data
+/// \return false if the connection closed
+static bool
+spp_write(Connection& c, uint32_t handle, uint32_t len, uint8_t const* data) {
   for (;;) {
-    esp_task_wdt_reset();
+    if (c.congested || c.pending_writes >= bt_spp_max_pending_writes)
+      telemetry.uart_to_bt.tx_stalls.fetch_add(1u, std::memory_order_relaxed);
+    while (alive(c) &&
+           (c.congested || c.pending_writes >= bt_spp_max_pending_writes))
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!alive(c)) return false;
+
+    ++c.pending_writes;
+    if (esp_spp_write(handle, len, const_cast<uint8_t*>(data)) == ESP_OK)
+      return true;
+    --c.pending_writes;
+    telemetry.spp_write_errors.fetch_add(1u, std::memory_order_relaxed);
+
+    // Write got rejected without an event to wait for, retry on next tick
+    ulTaskNotifyTake(pdTRUE, 1);
+  }
+}
+
+/// Send data to SPP in writes of whole RFCOMM frames
+///
+/// Data gets written straight away as long as it fills frames, the rest is
+/// kept back until more data completes a frame or spp_flush.
+///
+/// \param  c       Connection
+/// \param  handle  BT connection handle
+/// \param  len     Length of data
+/// \param  data    Data
+/// \return false if the connection closed
+static bool
+spp_send(Connection& c, uint32_t handle, size_t len, uint8_t const* data) {
+  // Complete the frame kept back
+  if (c.segment_fill) {
+    auto const n{std::min(len, bt_spp_mtu - c.segment_fill)};
+    std::memcpy(&c.segment[c.segment_fill], data, n);
+    c.segment_fill += n;
+    data += n;
+    len -= n;
+    if (c.segment_fill < bt_spp_mtu) return true;
+    c.segment_fill = 0u;
+    if (!spp_write(c, handle, bt_spp_mtu, c.segment.data())) return false;
+  }
+
+  // Whole frames
+  if (auto const n{len / bt_spp_mtu * bt_spp_mtu}) {
+    if (!spp_write(c, handle, n, data)) return false;
+    data += n;
+    len -= n;
+  }
+
+  std::memcpy(c.segment.data(), data, len);
+  c.segment_fill = len;
+  return true;
+}
+
+/// Write the data kept back by spp_send
+///
+/// \param  c       Connection
+/// \param  handle  BT connection handle
+/// \return false if the connection closed
+static bool spp_flush(Connection& c, uint32_t handle) {
+  auto const len{std::exchange(c.segment_fill, 0u)};
+  return !len || spp_write(c, handle, len, c.segment.data());
+}
+
+/// Pick the next chunk, ports take turns by weight (deficit round robin)
+///
+/// A port gets weight chunks worth of bytes at the start of its turn and sends
+/// as long as its head chunk fits. Ports without data lose what they had left.
+///
+/// \param  peer  Peer index
+/// \param  ports Number of ports the link carries
+/// \param  port  Port of chunk
+/// \return Chunk or nullptr if no port has data
+static uart_chunk* schedule(size_t peer, size_t ports, size_t& port) {
+  auto& c{connections[peer]};
+  auto& channels{uart_channels[peer]};
+  if (c.turn >= ports) c.turn = 0u;
+  for (size_t i{}; i <= 2u * ports; ++i) {
+    auto const chunk{channels[c.turn].receive(0)};
+    if (chunk && chunk->len <= c.deficits[c.turn]) {
+      c.deficits[c.turn] -= chunk->len;
+      port = c.turn;
+      return chunk;
+    }
+    if (chunk && !c.granted) {
+      c.deficits[c.turn] += uart_ports[c.turn].weight * uart_chunk_size;
+      c.granted = true;
+      continue;
+    }
+    if (!chunk) c.deficits[c.turn] = 0u;
+    c.turn = (c.turn + 1u) % ports;
+    c.granted = false;
+  }
+  return nullptr;
+}
 
-    // Receive ring buffer handle from queue
-    RingbufHandle_t uart_buf{nullptr};
-    if (!xQueueReceive(uart_queue, &uart_buf, portMAX_DELAY)) continue;
+/// Receive the next chunk from the priority lane
+///
+/// \param  peer  Peer index
+/// \param  ports Number of ports the link carries
+/// \param  port  Port of chunk
+/// \return Chunk or nullptr if the lane is empty
+static priority_channel_t::Item*
+receive_priority(size_t peer, size_t ports, size_t& port) {
+  if (peer >= size(uart_priority_channels)) return nullptr;
+  for (size_t i{}; i < ports; ++i)
+    if (auto const chunk{uart_priority_channels[peer][i].receive(0)}) {
+      port = i;
+      return chunk;
+    }
+  return nullptr;
+}
 
-    // Receive data from ring buffer
-    uint8_t* data{nullptr};
-    size_t len{};
-    while (
-      !(data = (uint8_t*)xRingbufferReceive(uart_buf, &len, pdMS_TO_TICKS(10))))
-      vTaskDelay(pdMS_TO_TICKS(10));
+/// Receive the next chunk from the UART channels
+///
+/// \param  peer  Peer index
+/// \param  ports Number of ports the link carries
+/// \param  port  Port of chunk
+/// \param  ticks Ticks to wait if no port has data
+/// \return Chunk or nullptr on timeout, once the priority lane got a chunk or
+///         once bt_tx_wake ended a wait without timeout
+static uart_chunk*
+receive(size_t peer, size_t ports, size_t& port, TickType_t ticks) {
+  auto const& c{connections[peer]};
+  auto const start{xTaskGetTickCount()};
+  for (;;) {
+    if (auto const chunk{schedule(peer, ports, port)}) return chunk;
 
-    // Write data to SPP
-    while (esp_spp_write(handle, len, data) != ESP_OK)
-      vTaskDelay(pdMS_TO_TICKS(10));
+    // Park until any channel got an item
+    bool ready{}, priority{};
+    for (size_t i{}; i < ports; ++i) {
+      ready |= uart_channels[peer][i].arm();
+      if (peer < size(uart_priority_channels))
+        priority |= uart_priority_channels[peer][i].arm();
+    }
+    if (priority) return nullptr;
+    if (ready) continue;
+    auto const elapsed{xTaskGetTickCount() - start};
+    if (elapsed >= ticks) return nullptr;
+    ulTaskNotifyTake(pdTRUE, ticks - elapsed);
+    if (ticks == portMAX_DELAY && !c.idle_wait) return nullptr;
+  }
+}
 
-    // Return item from ring buffer
-    vRingbufferReturnItem(uart_buf, (void*)data);
+/// Ticks bt_tx_task waits for UART data
+///
+/// Data kept back gets written right away if there is none. Once the link is
+/// idle and nothing is due the wait has no timeout, so the CPU may sleep until
+/// the next traffic. Otherwise acknowledgements go out every
+/// bt_spp_ack_interval. bt_tx_wake ends a wait without timeout.
+///
+/// \param  peer    Peer index
+/// \param  framed  Link is framed
+/// \return Ticks to wait
+static TickType_t receive_ticks(size_t peer, bool framed) {
+  auto& c{connections[peer]};
+  if (c.segment_fill) return 0u;
+  if (c.idle) {
+    c.idle_wait = true;
+    if (!framed || link_settled(peer)) return portMAX_DELAY;
+    c.idle_wait = false;
   }
+  return pdMS_TO_TICKS(bt_spp_ack_interval);
+}
+
+/// Hand a chunk back to the UART channel
+///
+/// \param  peer  Peer index
+/// \param  port  Port of chunk
+static void release(size_t peer, size_t port) {
+  uart_channels[peer][port].release();
+  uart_flow_control_update(port);
+}
+
+/// Acknowledge received frames and write whatever is kept back
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \return false if the connection closed
+static bool spp_write_ack(size_t peer, uint32_t handle) {
+  auto& c{connections[peer]};
+  size_t len{};
+  auto const ack{link_ack(peer, len)};
+  return (!ack || spp_send(c, handle, len, ack)) && spp_flush(c, handle);
 }
 
-/// Start BT transmit task on application core
-void bt_task_start_up(uint32_t handle) {
-  xTaskCreatePinnedToCore(&bt_tx_task,
-                          "bt_tx_task",
-                          2048,
-                          (void*)handle,
-                          task_priority_bt_tx,
-                          NULL,
-                          APP_CPU_NUM);
+/// Send again every frame from where link_retransmit stands
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \return false if the connection closed
+static bool retransmit(size_t peer, uint32_t handle) {
+  auto& c{connections[peer]};
+  size_t len{};
+  for (uint8_t const* frame; (frame = link_retransmit(peer, len));)
+    if (!spp_send(c, handle, len, frame)) return false;
+  return true;
+}
+
+/// Ask the peer to send again what a full BT channel dropped, and send again
+/// what the peer dropped
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \return false if the connection closed
+static bool rewind(size_t peer, uint32_t handle) {
+  auto& c{connections[peer]};
+  size_t len{};
+  if (auto const frame{link_rewind_request(peer, len)})
+    if (!spp_send(c, handle, len, frame) || !spp_flush(c, handle))
+      return false;
+  return !link_rewind(peer) || retransmit(peer, handle);
+}
+
+/// Send a self-test frame which is due
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \return false if the connection closed
+static bool spp_write_selftest(size_t peer, uint32_t handle) {
+  auto& c{connections[peer]};
+  size_t len{};
+  auto const frame{link_selftest(peer, len)};
+  return !frame || spp_send(c, handle, len, frame);
+}
+
+/// Negotiate link mode and resume the stream
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \param  framed  Link is framed
+/// \return false if the connection closed
+static bool negotiate(size_t peer, uint32_t handle, bool& framed) {
+  auto& c{connections[peer]};
+
+  // Master sends hello right away, slave only once it got one
+  size_t hello_len{};
+  auto const hello{link_hello(hello_len)};
+  auto const hello_first{link_hello_first(peer)};
+  if (hello_first && !spp_write(c, handle, hello_len, hello)) return false;
+  framed = link_wait(peer);
+  if (!alive(c)) return false;
+  ESP_LOGI(bt_spp_tag, "link %s", framed ? "framed" : "raw");
+  if (!framed) return true;
+  if (!hello_first && !spp_write(c, handle, hello_len, hello)) return false;
+
+  // Tell the peer where to resume and send again what it misses, a self-test
+  // start which is still due goes first
+  size_t len{};
+  auto const resume{link_resume(peer, len)};
+  if (!spp_write(c, handle, len, resume)) return false;
+  if (!link_wait_resume(peer)) {
+    if (!alive(c)) return false;
+    ESP_LOGE(bt_spp_tag, "%s no resume from peer", __func__);
+    esp_spp_disconnect(handle);
+    return false;
+  }
+  return spp_write_selftest(peer, handle) && retransmit(peer, handle);
+}
+
+/// Frame a chunk if the link is framed and send it
+///
+/// A framed chunk stays in the replay buffer and gets released right away, a
+/// raw one once it got written. Chunks of the priority lane don't wait for
+/// more data to fill a RFCOMM frame. A self-test start goes ahead of the chunk,
+/// it might be the first one the self-test generated.
+///
+/// \param  peer      Peer index
+/// \param  handle    BT connection handle
+/// \param  framed    Link is framed
+/// \param  port      Port of chunk
+/// \param  chunk     Chunk
+/// \param  priority  Chunk of the priority lane
+/// \param  release   Hands the chunk back to its channel
+/// \return false if the connection closed
+template<typename Chunk, typename F>
+static bool send_chunk(size_t peer,
+                       uint32_t handle,
+                       bool framed,
+                       size_t port,
+                       Chunk const& chunk,
+                       bool priority,
+                       F&& release) {
+  auto& c{connections[peer]};
+  telemetry_residency(telemetry.uart_to_bt, chunk.stamp);
+
+  // Write data to SPP
+  size_t len{chunk.len};
+  uint8_t const* data{chunk.data};
+  if (framed) {
+    if (!spp_write_selftest(peer, handle)) return false;
+    data = link_encode(peer, port, chunk.data, chunk.len, len, priority);
+    telemetry.uart_to_bt.tx_bytes.fetch_add(chunk.len,
+                                            std::memory_order_relaxed);
+    release();
+  }
+  if (!spp_send(c, handle, len, data) || (priority && !spp_flush(c, handle)))
+    return false;
+  telemetry.link_tx_bytes.fetch_add(len, std::memory_order_relaxed);
+  if (framed) return true;
+
+  // Release chunk
+  telemetry.uart_to_bt.tx_bytes.fetch_add(len, std::memory_order_relaxed);
+  release();
+  return true;
+}
+
+/// BT transmit task
+///
+/// Lives from boot on and serves one connection to its peer after the other.
+/// Framed links get every chunk encoded and keep it for retransmission, so
+/// nothing is lost if the connection closes. Raw links get chunks written as
+/// they are, a chunk which didn't make it is written once the next connection
+/// opened. While there is no connection UART data piles up in the UART
+/// channels of the peer. Every peer of a hub has its own task, a slow link
+/// only holds up its own channels.
+///
+/// Writes get cut to whole RFCOMM frames, the tail of a chunk waits for the
+/// next one as long as the channels have more right away. A raw link loses
+/// such a tail if the connection closes, just like data Bluedroid queued.
+/// Chunks of the priority lane go ahead of all others.
+///
+/// \param  pvParameter Peer index
+static void bt_tx_task(void* pvParameter) {
+  auto const peer{reinterpret_cast<size_t>(pvParameter)};
+  auto& c{connections[peer]};
+  for (;;) {
+    auto const handle{wait_for_connection(c)};
+    c.segment_fill = 0u;
+    c.idle = false;
+
+    bool framed{};
+    if (!negotiate(peer, handle, framed)) continue;
+    auto const ports{framed ? link_ports(peer) : 1u};
+    ESP_LOGI(
+      bt_spp_tag, "link carries %u ports", static_cast<unsigned>(ports));
+
+    // Unless the connection closed meanwhile
+    auto expected{BtState::Negotiating};
+    if (alive(c) &&
+        c.state.compare_exchange_strong(expected, BtState::Streaming))
+      ESP_LOGI(
+        bt_tag, "peer %u state streaming", static_cast<unsigned>(peer));
+
+    while (alive(c)) {
+      esp_task_wdt_reset();
+      if (framed &&
+          !(rewind(peer, handle) && spp_write_selftest(peer, handle)))
+        break;
+
+      // Priority lane first, it may take the last slot of the replay buffer
+      size_t port{};
+      if (!framed || !link_replay_full(peer, true))
+        if (auto const chunk{receive_priority(peer, ports, port)}) {
+          if (!send_chunk(peer, handle, framed, port, *chunk, true, [&] {
+                uart_priority_channels[peer][port].release();
+              }))
+            break;
+          continue;
+        }
+
+      // Wait for room in the replay buffer and keep acknowledging meanwhile,
+      // the peer might wait for room just as well
+      if (framed && link_replay_full(peer)) {
+        if (!spp_write_ack(peer, handle)) break;
+        link_wait_replay(peer, pdMS_TO_TICKS(bt_spp_ack_interval));
+        continue;
+      }
+
+      // Receive chunk from channels, if there is none write what's kept back
+      // and acknowledge
+      auto const chunk{
+        receive(peer, ports, port, receive_ticks(peer, framed))};
+      c.idle_wait = false;
+      c.idle = power_update(peer);
+      if (!chunk) {
+        if (!(framed ? spp_write_ack(peer, handle) : spp_flush(c, handle)))
+          break;
+        continue;
+      }
+      if (!send_chunk(peer, handle, framed, port, *chunk, false, [&] {
+            release(peer, port);
+          }))
+        break;
+    }
+  }
+}
+
+/// Start BT transmit tasks of every peer as task_placement says
+///
+/// The tasks outlive connections, they get started once at boot.
+void bt_task_start_up() {
+  for (size_t peer{}; peer < bt_max_peers; ++peer) {
+    auto& c{connections[peer]};
+    if (c.task) continue;
+    c.task = tasks[peer].create(&bt_tx_task,
+                                task_names[peer],
+                                reinterpret_cast<void*>(peer),
+                                task_placement.bt_tx);
+    telemetry_register_task(c.task);
+  }
+}
+
+/// Called from SPP callback when a connection opened
+///
+/// The handle only gets swapped while no connection is open, bt_tx_task picks
+/// it up together with the new counter.
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+void bt_connection_opened(size_t peer, uint32_t handle) {
+  auto& c{connections[peer]};
+  if (c.counter.load() & 1u) ++c.counter;
+  c.spp_handle = handle;
+  ++c.counter;
+  telemetry.link_connections.fetch_add(1u, std::memory_order_relaxed);
+  set_state(c, BtState::Negotiating);
+  if (c.task) xTaskNotifyGive(c.task);
+}
+
+/// Called from SPP callback when a connection closed
+///
+/// \param  peer  Peer index
+void bt_connection_closed(size_t peer) {
+  auto& c{connections[peer]};
+  if (c.counter.load() & 1u) ++c.counter;
+  c.pending_writes = 0u;
+  c.congested = false;
+  c.idle_wait = false;
+  if (c.state.load() != BtState::Idle) set_state(c, BtState::Reconnecting);
+  if (c.task) xTaskNotifyGive(c.task);
+}
+
+/// Current connection state
+///
+/// \param  peer  Peer index
+BtState bt_state(size_t peer) { return connections[peer].state.load(); }
+
+/// Update congestion status
+///
+/// \param  c     Connection
+/// \param  cong  Congestion status
+static void set_congested(Connection& c, bool cong) {
+  if (c.congested.exchange(cong) != cong && cong)
+    telemetry.spp_congestions.fetch_add(1u, std::memory_order_relaxed);
+}
+
+/// Called from SPP callback when a write completed
+///
+/// Writes of a connection which closed meanwhile got written off already by
+/// bt_connection_closed and don't count.
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle of the write
+/// \param  cong    Congestion status
+void bt_tx_write_done(size_t peer, uint32_t handle, bool cong) {
+  auto& c{connections[peer]};
+  if (!(c.counter.load() & 1u) || c.spp_handle.load() != handle) return;
+  set_congested(c, cong);
+  for (auto n{c.pending_writes.load()};
+       n && !c.pending_writes.compare_exchange_weak(n, n - 1u);)
+    ;
+  if (c.task) xTaskNotifyGive(c.task);
+}
+
+/// Called from SPP callback when the congestion status changed
+///
+/// \param  peer  Peer index
+/// \param  cong  Congestion status
+void bt_tx_cong_changed(size_t peer, bool cong) {
+  auto& c{connections[peer]};
+  set_congested(c, cong);
+  if (c.task) xTaskNotifyGive(c.task);
+}
+
+/// Called from SPP callback when data arrived
+///
+/// The data might need an acknowledgement.
+///
+/// \param  peer  Peer index
+void bt_tx_data_received(size_t peer) { bt_tx_wake(peer); }
+
+/// End a wait of bt_tx_task without timeout, something is due on the link
+///
+/// \param  peer  Peer index
+void bt_tx_wake(size_t peer) {
+  auto& c{connections[peer]};
+  if (c.idle_wait.exchange(false) && c.task) xTaskNotifyGive(c.task);
 }
 
 /// Initialize BT
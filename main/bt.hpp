@@ -6,7 +6,23 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
+/// Connection state
+enum class BtState : uint8_t {
+  Idle,          ///< Never connected, looking for or waiting for the peer
+  Negotiating,   ///< Connection open, link mode gets negotiated
+  Streaming,     ///< Connection open, data flows
+  Reconnecting,  ///< Connection lost, UART data gets buffered meanwhile
+};
+
 void bt_init();
-void bt_task_start_up(uint32_t handle);
\ No newline at end of file
+void bt_task_start_up();
+void bt_connection_opened(size_t peer, uint32_t handle);
+void bt_connection_closed(size_t peer);
+BtState bt_state(size_t peer = 0u);
+void bt_tx_write_done(size_t peer, uint32_t handle, bool cong);
+void bt_tx_cong_changed(size_t peer, bool cong);
+void bt_tx_data_received(size_t peer);
+void bt_tx_wake(size_t peer);
\ No newline at end of file
@@ -15,17 +15,27 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <algorithm>
+#include <bt_gap.hpp>
 #include <bt_spp.hpp>
 #include <cstdint>
 #include <cstring>
 #include <limits>
+#include <utility>
 #include "config.hpp"
+#include "peer.hpp"
+#include "power.hpp"
 
 /// Own BT device address
 esp_bd_addr_t own_bda{};
 
-/// Remote BT device address
-esp_bd_addr_t remote_bda{};
+/// Remote BT device addresses, a hub has up to bt_max_peers
+esp_bd_addr_t remote_bdas[bt_max_peers]{};
+
+/// Number of remote BT device addresses
+size_t remote_count{};
+
+/// Remote device is a hub
+bool remote_hub{};
 
 // random only works when RF subsystem is enabled
 
@@ -39,17 +49,26 @@ static uint32_t random_interval(uint32_t min, uint32_t max) {
                  std::numeric_limits<uint32_t>::max();
 }
 
-/// Check if BT device address is valid
+/// Check if BT device address is one of the remote ones already
 ///
 /// \param  bda   BT device address
-/// \return true  BT device address valid
-/// \return false BT device address invalid
-static bool is_valid_bda(esp_bd_addr_t const& bda) {
-  for (auto i{0u}; i < ESP_BD_ADDR_LEN; ++i)
-    if (bda[i] != 0) return true;
+/// \return true  BT device address known
+/// \return false BT device address unknown
+static bool is_known_bda(esp_bd_addr_t const& bda) {
+  for (size_t i{}; i < remote_count; ++i)
+    if (!memcmp(remote_bdas[i], bda, sizeof(esp_bd_addr_t))) return true;
   return false;
 }
 
+/// BT SPP got initialized
+static bool spp_started{};
+
+/// Initialize BT SPP once the remote devices are known
+static void start_spp() {
+  if (std::exchange(spp_started, true)) return;
+  bt_spp_init();
+}
+
 /// Convert BT device address to string
 ///
 /// \param  bda   BT device address
@@ -103,10 +122,13 @@ get_name_from_eir(uint8_t* eir, uint8_t* bdname, uint8_t* bdname_len) {
 
 /// Check if discovery event found remote ESP32
 ///
+/// A hub only looks for bridges, bridges look for each other and for hubs.
+///
 /// \param  param A2DP state callback parameters
+/// \param  hub   Remote ESP32 is a hub
 /// \return true  Discovery event found remote ESP32
 /// \return false Discovery event found something else
-static bool is_remote_esp_device(esp_bt_gap_cb_param_t* param) {
+static bool is_remote_esp_device(esp_bt_gap_cb_param_t* param, bool& hub) {
   // TODO Not sure if this doesn't blow up the stack? We have 3584 bytes which
   // is a lot... but still?
   uint8_t bdname[ESP_BT_GAP_MAX_BDNAME_LEN + 1];
@@ -164,7 +186,9 @@ static bool is_remote_esp_device(esp_bt_gap_cb_param_t* param) {
     }
   }
 
-  return bdname_len && !strcmp((char*)bdname, bt_dev_name);
+  if (!bdname_len) return false;
+  hub = !bt_hub && !strcmp((char*)bdname, bt_hub_dev_name);
+  return hub || !strcmp((char*)bdname, bt_dev_name);
 }
 
 /// BT GAP callback
@@ -177,20 +201,28 @@ static void bt_app_gap_cb(esp_bt_gap_cb_event_t event,
     // device discovery result event
     case ESP_BT_GAP_DISC_RES_EVT:
       ESP_LOGI(bt_gap_tag, "ESP_BT_GAP_DISC_RES_EVT");
-      // Found remote esp
-      if (is_remote_esp_device(param)) {
-        memcpy(remote_bda, param->disc_res.bda, sizeof(esp_bd_addr_t));
+      // Found remote esp, a hub keeps looking until it found all its peers
+      if (bool hub{}; remote_count < bt_max_peers &&
+                      !is_known_bda(param->disc_res.bda) &&
+                      is_remote_esp_device(param, hub)) {
+        memcpy(remote_bdas[remote_count++],
+               param->disc_res.bda,
+               sizeof(esp_bd_addr_t));
+        remote_hub = hub;
+        if (remote_count < bt_max_peers) break;
         esp_bt_gap_cancel_discovery();
-        bt_spp_init();
+        start_spp();
       }
       break;
 
     // discovery state changed event
     case ESP_BT_GAP_DISC_STATE_CHANGED_EVT:
       ESP_LOGI(bt_gap_tag, "ESP_BT_GAP_DISC_STATE_CHANGED_EVT");
-      // Restart discovery if we haven't found remote esp
-      if (param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STOPPED &&
-          !is_valid_bda(remote_bda))
+      // Restart discovery if we haven't found remote esp, a hub settles for
+      // the peers found so far
+      if (param->disc_st_chg.state != ESP_BT_GAP_DISCOVERY_STOPPED) break;
+      if (remote_count) start_spp();
+      else
         esp_bt_gap_start_discovery(
           ESP_BT_INQ_MODE_GENERAL_INQUIRY,
           random_interval(inquiry_duration_min, inquiry_duration_max),
@@ -266,6 +298,23 @@ static void bt_app_gap_cb(esp_bt_gap_cb_event_t event,
       ESP_LOGI(bt_gap_tag, "ESP_BT_GAP_READ_RSSI_DELTA_EVT");
       break;
 
+    // QoS setup (poll interval) completed
+    case ESP_BT_GAP_QOS_CMPL_EVT:
+      ESP_LOGI(bt_gap_tag,
+               "ESP_BT_GAP_QOS_CMPL_EVT t_poll %lu",
+               static_cast<unsigned long>(param->qos_cmpl.t_poll));
+      if (param->qos_cmpl.stat == ESP_BT_STATUS_SUCCESS)
+        power_qos_done(param->qos_cmpl.bda, param->qos_cmpl.t_poll);
+      break;
+
+    // Power mode of a link changed
+    case ESP_BT_GAP_MODE_CHG_EVT:
+      ESP_LOGI(bt_gap_tag,
+               "ESP_BT_GAP_MODE_CHG_EVT mode %d",
+               static_cast<int>(param->mode_chg.mode));
+      power_mode_changed(param->mode_chg.mode == ESP_BT_PM_MD_SNIFF);
+      break;
+
     //
     case ESP_BT_GAP_EVT_MAX: break;
 
@@ -286,7 +335,7 @@ void bt_gap_init() {
   esp_bt_pin_code_t pin_code;
   esp_bt_gap_set_pin(pin_type, 0, pin_code);
 
-  esp_bt_dev_set_device_name(bt_dev_name);
+  esp_bt_dev_set_device_name(bt_hub ? bt_hub_dev_name : bt_dev_name);
 
   // Get own BT device address
   uint8_t const* adr{esp_bt_dev_get_address()};
@@ -304,9 +353,34 @@ void bt_gap_init() {
   // Register GAP callback function
   esp_bt_gap_register_callback(bt_app_gap_cb);
 
+  // Connect a known peer right away, a hub discovers its peers on every boot
+  if (Peer peer{}; !bt_hub && peer_load(peer)) {
+    memcpy(remote_bdas[0u], peer.bda, sizeof(esp_bd_addr_t));
+    remote_count = 1u;
+    ESP_LOGI(bt_gap_tag,
+             "Known peer: %s",
+             bda2str(remote_bdas[0u], bda_str, sizeof(bda_str)));
+    start_spp();
+    return;
+  }
+
   // Start to discover nearby Bluetooth devices
   esp_bt_gap_start_discovery(
     ESP_BT_INQ_MODE_GENERAL_INQUIRY,
     random_interval(inquiry_duration_min, inquiry_duration_max),
     0);
+}
+
+/// Forget the remote devices and discover them again
+///
+/// Must only be called once BT SPP shut down, it gets initialized again once
+/// discovery found remote devices.
+void bt_gap_start_discovery() {
+  remote_count = 0u;
+  remote_hub = false;
+  spp_started = false;
+  esp_bt_gap_start_discovery(
+    ESP_BT_INQ_MODE_GENERAL_INQUIRY,
+    random_interval(inquiry_duration_min, inquiry_duration_max),
+    0);
 }
\ No newline at end of file
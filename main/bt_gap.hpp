@@ -7,11 +7,20 @@
 #pragma once
 
 #include <esp_bt_device.h>
+#include <cstddef>
+#include "config.hpp"
 
 void bt_gap_init();
+void bt_gap_start_discovery();
 
 /// Own BT device address
 extern esp_bd_addr_t own_bda;
 
-/// Remote BT device address
-extern esp_bd_addr_t remote_bda;
\ No newline at end of file
+/// Remote BT device addresses, a hub has up to bt_max_peers
+extern esp_bd_addr_t remote_bdas[bt_max_peers];
+
+/// Number of remote BT device addresses
+extern size_t remote_count;
+
+/// Remote device is a hub
+extern bool remote_hub;
\ No newline at end of file
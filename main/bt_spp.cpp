@@ -11,19 +11,23 @@
 #include <esp_log.h>
 #include <esp_spp_api.h>
 #include <esp_system.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/ringbuf.h>
 #include <freertos/task.h>
+#include <array>
+#include <atomic>
 #include <bt.hpp>
 #include <bt_gap.hpp>
 #include <cstdint>
 #include <cstring>
 #include "config.hpp"
+#include "link.hpp"
+#include "peer.hpp"
+#include "power.hpp"
 #include "queue.hpp"
-#include "uart.hpp"
 
-QueueHandle_t bt_queue{nullptr};
-static RingbufHandle_t bt_buf{nullptr};
+std::array<bt_channel_t, size(uart_ports)> bt_channels;
+std::array<priority_channel_t, size(uart_ports)> bt_priority_channels;
 
 /// Check if BT SPP should take the role of master or slave based on own and
 /// remote BT device address.
@@ -42,18 +46,107 @@ static esp_spp_role_t spp_master_or_slave(esp_bd_addr_t const& own,
   return ESP_SPP_ROLE_MASTER;
 }
 
-/// Write to BT buffer
+/// Peers as known from NVS or SDP discovery
+static std::array<Peer, bt_max_peers> peers{};
+
+/// Current connection attempt of a peer succeeded
+static std::array<bool, bt_max_peers> opened{};
+
+/// Handles of the connections to the peers
+static std::array<uint32_t, bt_max_peers> handles{};
+
+/// Peers waiting for a connection attempt (bit mask)
+static uint32_t pending{};
+
+/// Peer whose connection attempt runs, bt_max_peers if none does
+static size_t connecting{bt_max_peers};
+
+/// Timer which forgets a known peer
+static esp_timer_handle_t peer_timer{};
+
+/// SPP shuts down to search for peers again
+static std::atomic<bool> rediscovering{};
+
+/// Forget a known peer which didn't connect in time and search for one again
 ///
-/// \param  param SPP callback parameters union
-static void write_to_bt_buf(esp_spp_cb_param_t* param) {
-  // Send data to ring buffer
-  while (!xRingbufferSend(
-    bt_buf, param->data_ind.data, param->data_ind.len, pdMS_TO_TICKS(10)))
-    ;
-
-  // Send ring buffer handle to queue
-  while (!xQueueSend(bt_queue, &bt_buf, pdMS_TO_TICKS(10)))
-    ;
+/// SPP shuts down first, once ESP_SPP_UNINIT_EVT arrived discovery starts over
+/// and initializes SPP again with whatever peer it finds.
+///
+/// \param  arg Unused
+static void peer_timeout([[maybe_unused]] void* arg) {
+  ESP_LOGW(bt_spp_tag, "%s known peer didn't connect", __func__);
+  peer_forget();
+  rediscovering = true;
+  esp_spp_deinit();
+}
+
+/// Reset the peers once SPP shut down and discover them again
+static void rediscover() {
+  peers = {};
+  opened = {};
+  handles = {};
+  pending = 0u;
+  connecting = bt_max_peers;
+  rediscovering = false;
+  bt_gap_start_discovery();
+}
+
+/// Find the peer a connection handle belongs to
+///
+/// \param  handle  BT connection handle
+/// \return Peer index or bt_max_peers if the handle is unknown
+static size_t peer_of(uint32_t handle) {
+  for (size_t i{}; i < bt_max_peers; ++i)
+    if (handles[i] == handle) return i;
+  return bt_max_peers;
+}
+
+/// Start the next connection attempt, skip SDP discovery if the server channel
+/// of the peer is known
+///
+/// Attempts run one after the other, SDP and paging of several peers at once
+/// only get in each other's way.
+static void connect() {
+  if (rediscovering || connecting < bt_max_peers) return;
+  for (size_t i{}; i < remote_count; ++i) {
+    if (!(pending & (1u << i))) continue;
+    pending &= ~(1u << i);
+    connecting = i;
+    if (peers[i].scn && esp_spp_connect(ESP_SPP_SEC_AUTHENTICATE,
+                                        ESP_SPP_ROLE_MASTER,
+                                        peers[i].scn,
+                                        remote_bdas[i]) == ESP_OK)
+      return;
+    esp_spp_start_discovery(remote_bdas[i]);
+    return;
+  }
+}
+
+/// Queue a connection attempt to a peer
+///
+/// \param  i Peer index
+static void request(size_t i) {
+  pending |= 1u << i;
+  connect();
+}
+
+/// Remember the peer once a connection opened
+///
+/// The address stored is the one of the device which actually connected, a
+/// slave may get connected by another master than the one it found. A hub
+/// doesn't store its peers, it discovers them on every boot.
+///
+/// \param  i     Peer index
+/// \param  role  Own SPP role
+/// \param  bda   BT device address of the connected peer
+static void remember(size_t i, esp_spp_role_t role, esp_bd_addr_t const& bda) {
+  opened[i] = true;
+  if constexpr (bt_hub) return;
+  if (peer_timer) esp_timer_stop(peer_timer);
+  auto& peer{peers[i]};
+  std::memcpy(peer.bda, bda, sizeof(peer.bda));
+  peer.role = role;
+  peer_store(peer);
 }
 
 /// BT SPP callback for ESP_SPP_ROLE_MASTER
@@ -66,7 +159,13 @@ static void bt_spp_master_cb(esp_spp_cb_event_t event,
     // When SPP is inited, the event comes
     case ESP_SPP_INIT_EVT:
       ESP_LOGI(bt_spp_master_tag, "ESP_SPP_INIT_EVT");
-      esp_spp_start_discovery(remote_bda);
+      for (size_t i{}; i < remote_count; ++i) request(i);
+      break;
+
+    // When SPP is deinited, the event comes
+    case ESP_SPP_UNINIT_EVT:
+      ESP_LOGI(bt_spp_master_tag, "ESP_SPP_UNINIT_EVT");
+      rediscover();
       break;
 
     // When SDP discovery complete, the event comes
@@ -75,29 +174,59 @@ static void bt_spp_master_cb(esp_spp_cb_event_t event,
                "ESP_SPP_DISCOVERY_COMP_EVT status=%d scn_num=%d",
                param->disc_comp.status,
                param->disc_comp.scn_num);
+      if (connecting >= bt_max_peers) break;
       // Discovery successful -> connect
-      if (param->disc_comp.status == ESP_SPP_SUCCESS)
+      if (auto& peer{peers[connecting]};
+          param->disc_comp.status == ESP_SPP_SUCCESS) {
+        auto const name{param->disc_comp.service_name[0]};
+        peer.capable = name && std::strstr(name, bt_spp_capability_tag);
+        peer.scn = param->disc_comp.scn[0];
         esp_spp_connect(ESP_SPP_SEC_AUTHENTICATE,
                         ESP_SPP_ROLE_MASTER,
-                        param->disc_comp.scn[0],
-                        remote_bda);
+                        peer.scn,
+                        remote_bdas[connecting]);
+      }
       // Else restart discovery
       else
-        esp_spp_start_discovery(remote_bda);
+        esp_spp_start_discovery(remote_bdas[connecting]);
       break;
 
     // When SPP Client connection open, the event comes
-    case ESP_SPP_OPEN_EVT:
+    case ESP_SPP_OPEN_EVT: {
       ESP_LOGI(bt_spp_master_tag, "ESP_SPP_OPEN_EVT");
-      bt_task_start_up(param->open.handle);
-      uart_task_start_up();
+      auto i{peer_of(param->open.handle)};
+      if (i >= bt_max_peers) i = connecting;
+      if (i >= bt_max_peers) break;
+      handles[i] = param->open.handle;
+      if (i == connecting) connecting = bt_max_peers;
+      remember(i, ESP_SPP_ROLE_MASTER, param->open.rem_bda);
+      link_open(
+        i, param->open.handle, ESP_SPP_ROLE_MASTER, peers[i].capable);
+      power_open(i, remote_bdas[i]);
+      bt_connection_opened(i, param->open.handle);
+      // Attempt of the next peer
+      connect();
       break;
+    }
 
     // When SPP connection closed, the event comes
-    case ESP_SPP_CLOSE_EVT:
+    case ESP_SPP_CLOSE_EVT: {
       ESP_LOGI(bt_spp_master_tag, "ESP_SPP_CLOSE_EVT");
-      esp_restart();
+      // A failed attempt might not have got a handle
+      auto i{peer_of(param->close.handle)};
+      if (i >= bt_max_peers) i = connecting;
+      if (i >= bt_max_peers) break;
+      bt_connection_closed(i);
+      link_close(i);
+      handles[i] = 0u;
+      // Reconnect, the stream resumes where it got interrupted. A server
+      // channel which didn't work gets discovered again.
+      if (!opened[i]) peers[i].scn = 0u;
+      opened[i] = false;
+      if (i == connecting) connecting = bt_max_peers;
+      request(i);
       break;
+    }
 
     // When SPP server started, the event comes
     case ESP_SPP_START_EVT:
@@ -107,25 +236,38 @@ static void bt_spp_master_cb(esp_spp_cb_event_t event,
     // When SPP client initiated a connection, the event comes
     case ESP_SPP_CL_INIT_EVT:
       ESP_LOGI(bt_spp_master_tag, "ESP_SPP_CL_INIT_EVT");
+      if (connecting < bt_max_peers)
+        handles[connecting] = param->cl_init.handle;
       break;
 
     // When SPP connection received data, the event comes, only for
     // ESP_SPP_MODE_CB
     case ESP_SPP_DATA_IND_EVT:
       ESP_LOGI(bt_spp_master_tag, "ESP_SPP_DATA_IND_EVT");
-      write_to_bt_buf(param);
+      if (auto const i{peer_of(param->data_ind.handle)}; i < bt_max_peers) {
+        power_activity();
+        link_receive(i,
+                     param->data_ind.handle,
+                     param->data_ind.data,
+                     param->data_ind.len);
+        bt_tx_data_received(i);
+      }
       break;
 
     // When SPP connection congestion status changed, the event comes, only for
     // ESP_SPP_MODE_CB
     case ESP_SPP_CONG_EVT:
       ESP_LOGI(bt_spp_master_tag, "ESP_SPP_CONG_EVT");
+      if (auto const i{peer_of(param->cong.handle)}; i < bt_max_peers)
+        bt_tx_cong_changed(i, param->cong.cong);
       break;
 
     // When SPP write operation completes, the event comes, only for
     // ESP_SPP_MODE_CB
     case ESP_SPP_WRITE_EVT:
       ESP_LOGI(bt_spp_master_tag, "ESP_SPP_WRITE_EVT");
+      if (auto const i{peer_of(param->write.handle)}; i < bt_max_peers)
+        bt_tx_write_done(i, param->write.handle, param->write.cong);
       break;
 
     // When SPP Server connection open, the event comes
@@ -151,6 +293,12 @@ static void bt_spp_slave_cb(esp_spp_cb_event_t event,
         ESP_SPP_SEC_AUTHENTICATE, ESP_SPP_ROLE_SLAVE, 0, bt_spp_server_name);
       break;
 
+    // When SPP is deinited, the event comes
+    case ESP_SPP_UNINIT_EVT:
+      ESP_LOGI(bt_spp_slave_tag, "ESP_SPP_UNINIT_EVT");
+      rediscover();
+      break;
+
     // When SDP discovery complete, the event comes
     case ESP_SPP_DISCOVERY_COMP_EVT:
       ESP_LOGI(bt_spp_slave_tag, "ESP_SPP_DISCOVERY_COMP_EVT");
@@ -164,7 +312,10 @@ static void bt_spp_slave_cb(esp_spp_cb_event_t event,
     // When SPP connection closed, the event comes
     case ESP_SPP_CLOSE_EVT:
       ESP_LOGI(bt_spp_slave_tag, "ESP_SPP_CLOSE_EVT");
-      esp_restart();
+      bt_connection_closed(0u);
+      link_close(0u);
+      handles[0u] = 0u;
+      // Server keeps listening, the stream resumes once the master reconnected
       break;
 
     // When SPP server started, the event comes
@@ -181,26 +332,36 @@ static void bt_spp_slave_cb(esp_spp_cb_event_t event,
     // ESP_SPP_MODE_CB
     case ESP_SPP_DATA_IND_EVT:
       ESP_LOGI(bt_spp_slave_tag, "ESP_SPP_DATA_IND_EVT");
-      write_to_bt_buf(param);
+      power_activity();
+      link_receive(0u,
+                   param->data_ind.handle,
+                   param->data_ind.data,
+                   param->data_ind.len);
+      bt_tx_data_received(0u);
       break;
 
     // When SPP connection congestion status changed, the event comes, only for
     // ESP_SPP_MODE_CB
     case ESP_SPP_CONG_EVT:
       ESP_LOGI(bt_spp_slave_tag, "ESP_SPP_CONG_EVT");
+      bt_tx_cong_changed(0u, param->cong.cong);
       break;
 
     // When SPP write operation completes, the event comes, only for
     // ESP_SPP_MODE_CB
     case ESP_SPP_WRITE_EVT:
       ESP_LOGI(bt_spp_slave_tag, "ESP_SPP_WRITE_EVT");
+      bt_tx_write_done(0u, param->write.handle, param->write.cong);
       break;
 
     // When SPP Server connection open, the event comes
     case ESP_SPP_SRV_OPEN_EVT:
       ESP_LOGI(bt_spp_slave_tag, "ESP_SPP_SRV_OPEN_EVT");
-      bt_task_start_up(param->srv_open.handle);
-      uart_task_start_up();
+      handles[0u] = param->srv_open.handle;
+      remember(0u, ESP_SPP_ROLE_SLAVE, param->srv_open.rem_bda);
+      link_open(0u, param->srv_open.handle, ESP_SPP_ROLE_SLAVE, false);
+      power_open(0u, param->srv_open.rem_bda);
+      bt_connection_opened(0u, param->srv_open.handle);
       break;
 
     default: break;
@@ -210,19 +371,26 @@ static void bt_spp_slave_cb(esp_spp_cb_event_t event,
 /// Initialize BT SPP
 void bt_spp_init() {
   ESP_LOGI(bt_spp_tag, "SPP init");
-  bt_buf = xRingbufferCreate(bt_spp_buf_size, RINGBUF_TYPE_NOSPLIT);
-  if (!bt_buf) {
-    ESP_LOGE(bt_spp_tag, "%s can't create ring buffer for SPP", __func__);
-    return;
+  // A hub is master of all its peers, a bridge which found a hub its slave
+  auto spp_role{bt_hub       ? ESP_SPP_ROLE_MASTER
+                : remote_hub ? ESP_SPP_ROLE_SLAVE
+                             : spp_master_or_slave(own_bda, remote_bdas[0u])};
+
+  // Take server channel and role of a known peer, forget it if it doesn't
+  // connect in time
+  if (Peer stored{};
+      !bt_hub && peer_load(stored) &&
+      !std::memcmp(stored.bda, remote_bdas[0u], sizeof(stored.bda))) {
+    peers[0u] = stored;
+    spp_role = stored.role;
+    esp_timer_create_args_t const args{.callback = &peer_timeout,
+                                       .arg = nullptr,
+                                       .dispatch_method = ESP_TIMER_TASK,
+                                       .name = "peer_timeout",
+                                       .skip_unhandled_events = false};
+    if (peer_timer || esp_timer_create(&args, &peer_timer) == ESP_OK)
+      esp_timer_start_once(peer_timer, bt_peer_timeout * 1000ull);
   }
-
-  bt_queue = xQueueCreate(8, sizeof(RingbufHandle_t));
-  if (!bt_queue) {
-    ESP_LOGE(bt_spp_tag, "%s can't create queue for SPP", __func__);
-    return;
-  }
-
-  auto spp_role{spp_master_or_slave(own_bda, remote_bda)};
   ESP_LOGI(bt_spp_tag, "Own device spp role: %d", spp_role);
 
   esp_err_t ret{esp_spp_register_callback(
@@ -0,0 +1,172 @@
+/// Channel
+///
+/// Single-producer/single-consumer channel of fixed size items. Data and
+/// signaling live in one object, so handing an item over takes a single
+/// atomic store instead of a ring buffer and a queue operation. Items are
+/// filled and drained in place.
+///
+/// Producer and consumer only block if the channel is full or empty. They
+/// then park on their task notification, the other side gives it once the
+/// state changed. Callers may use task notifications for other purposes as
+/// well as long as every wait re-checks its condition.
+///
+/// \file   channel.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+template<size_t Capacity, size_t MaxItem>
+class Channel {
+  static_assert(Capacity && !(Capacity & (Capacity - 1u)),
+                "Capacity must be a power of 2");
+
+public:
+  /// Item, the length isn't known until the producer filled the data
+  struct Item {
+    uint32_t len;
+    uint32_t stamp;  ///< Free for the producer (e.g. time of commit)
+    uint32_t tag;    ///< Free for the producer (e.g. where data came from)
+    uint8_t data[MaxItem];
+  };
+
+  /// Acquire a free item (producer)
+  ///
+  /// \param  ticks Ticks to wait for a free item
+  /// \return Item or nullptr on timeout
+  Item* acquire(TickType_t ticks) {
+    if (!wait(producer_, ticks, [this] { return !full(); })) return nullptr;
+    return &items_[tail_.load(std::memory_order_relaxed) & mask];
+  }
+
+  /// Publish the acquired item (producer)
+  void commit() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1u,
+                std::memory_order_release);
+    notify(consumer_);
+  }
+
+  /// Copy data into an item and publish it (producer)
+  ///
+  /// \param  data  Data
+  /// \param  len   Length of data
+  /// \param  ticks Ticks to wait for a free item
+  /// \return true if data got published
+  bool send(void const* data, size_t len, TickType_t ticks) {
+    if (len > MaxItem) return false;
+    auto const item{acquire(ticks)};
+    if (!item) return false;
+    item->len = static_cast<uint32_t>(len);
+    std::memcpy(item->data, data, len);
+    commit();
+    return true;
+  }
+
+  /// Get the oldest published item (consumer)
+  ///
+  /// \param  ticks Ticks to wait for an item
+  /// \return Item or nullptr on timeout
+  Item* receive(TickType_t ticks) {
+    if (!wait(consumer_, ticks, [this] { return !empty(); })) return nullptr;
+    return &items_[head_.load(std::memory_order_relaxed) & mask];
+  }
+
+  /// Announce the consumer as waiter without blocking (consumer)
+  ///
+  /// Lets a consumer serve several channels. It arms all of them, parks on its
+  /// task notification unless one of them has an item and checks them all
+  /// again once it got woken up.
+  ///
+  /// \return true if an item is available
+  bool arm() {
+    consumer_.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return !empty();
+  }
+
+  /// Hand the received item back (consumer)
+  ///
+  /// A blocked producer only gets woken once half of the items are free again,
+  /// otherwise a fast producer would be woken for every single item. The
+  /// consumer drains the channel before it blocks, so the wake-up can't get
+  /// lost.
+  void release() {
+    auto const head{head_.load(std::memory_order_relaxed) + 1u};
+    head_.store(head, std::memory_order_release);
+    if (tail_.load(std::memory_order_acquire) - head <= Capacity / 2u)
+      notify(producer_);
+  }
+
+  /// Number of published items which haven't been released yet
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  /// Maximum number of items
+  static constexpr size_t capacity() { return Capacity; }
+
+  /// Maximum size of an item
+  static constexpr size_t max_item() { return MaxItem; }
+
+private:
+  static constexpr uint32_t mask{Capacity - 1u};
+
+  bool full() const {
+    return tail_.load(std::memory_order_relaxed) -
+             head_.load(std::memory_order_acquire) >=
+           Capacity;
+  }
+
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) ==
+           head_.load(std::memory_order_relaxed);
+  }
+
+  /// Wait until ready returns true
+  ///
+  /// The waiter gets announced before ready is checked again, so a state change
+  /// in between can't get lost.
+  template<typename F>
+  static bool
+  wait(std::atomic<TaskHandle_t>& waiter, TickType_t ticks, F&& ready) {
+    if (ready()) return true;
+    auto const start{xTaskGetTickCount()};
+    for (;;) {
+      waiter.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready()) break;
+      auto const elapsed{xTaskGetTickCount() - start};
+      if (ticks != portMAX_DELAY && elapsed >= ticks) {
+        waiter.store(nullptr, std::memory_order_relaxed);
+        return false;
+      }
+      ulTaskNotifyTake(
+        pdTRUE, ticks == portMAX_DELAY ? portMAX_DELAY : ticks - elapsed);
+    }
+    waiter.store(nullptr, std::memory_order_relaxed);
+    return true;
+  }
+
+  /// Wake up a waiting task
+  static void notify(std::atomic<TaskHandle_t>& waiter) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!waiter.load(std::memory_order_relaxed)) return;
+    if (auto const task{waiter.exchange(nullptr, std::memory_order_relaxed)})
+      xTaskNotifyGive(task);
+  }
+
+  std::array<Item, Capacity> items_{};
+  std::atomic<uint32_t> head_{};
+  std::atomic<uint32_t> tail_{};
+  std::atomic<TaskHandle_t> producer_{};
+  std::atomic<TaskHandle_t> consumer_{};
+};
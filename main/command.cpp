@@ -0,0 +1,267 @@
+/// Command
+///
+/// \file   command.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include "command.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "baud_rate.hpp"
+#include "bt.hpp"
+#include "link.hpp"
+#include "selftest.hpp"
+#include "settings.hpp"
+#include "telemetry.hpp"
+
+namespace {
+
+/// Setting which AT+<NAME> reaches
+struct Parameter {
+  char const* name;
+  uint32_t min;
+  uint32_t max;
+  uint32_t (*get)();
+  bool (*set)(uint32_t);  ///< Returns false if the value got rejected
+};
+
+constexpr Parameter parameters[]{
+  {"BAUD",
+   static_cast<uint32_t>(supported_baud_rates.front()),
+   static_cast<uint32_t>(supported_baud_rates.back()),
+   [] { return settings.baud_rate.load(); },
+   [](uint32_t v) {
+     // Only supported baud rates, anything else would get detected away
+     if (static_cast<uint32_t>(nearest_baud_rate(v)) != v) return false;
+     settings.baud_rate = v;
+     return true;
+   }},
+  {"CHUNK",
+   1u,
+   uart_chunk_size,
+   [] { return settings.chunk_size.load(); },
+   [](uint32_t v) { return settings.chunk_size = v, true; }},
+  {"AGG",
+   static_cast<uint32_t>(Aggregation::Latency),
+   static_cast<uint32_t>(Aggregation::Adaptive),
+   [] { return static_cast<uint32_t>(settings.aggregation.load()); },
+   [](uint32_t v) {
+     return settings.aggregation = static_cast<Aggregation>(v), true;
+   }},
+  {"WINDOW",
+   1u,
+   command_guard_time,
+   [] { return settings.aggregation_window.load(); },
+   [](uint32_t v) { return settings.aggregation_window = v, true; }},
+  {"FLOW",
+   static_cast<uint32_t>(FlowControl::None),
+   static_cast<uint32_t>(FlowControl::Software),
+   [] { return static_cast<uint32_t>(settings.flow_control.load()); },
+   [](uint32_t v) {
+     // RTS/CTS only if the data port has the pins
+     auto const mode{static_cast<FlowControl>(v)};
+     if (mode == FlowControl::Hardware &&
+         !uart_hw_flow_control(uart_ports[0u]))
+       return false;
+     return settings.flow_control = mode, true;
+   }},
+};
+
+/// Names of the profiles in the order of Profile
+constexpr char const* profile_names[]{
+  "Default", "LowLatency", "HighThroughput", "LowMemory"};
+
+/// Append to reply
+///
+/// \param  reply Reply
+/// \param  max   Size of reply
+/// \param  fmt   Format
+/// \return true if it fit
+template<typename... Ts>
+bool append(char* reply, size_t max, char const* fmt, Ts... args) {
+  auto const len{std::strlen(reply)};
+  auto const n{std::snprintf(reply + len, max - len, fmt, args...)};
+  return n >= 0 && static_cast<size_t>(n) < max - len;
+}
+
+/// Settings as AT&V lists them
+void list(char* reply, size_t max) {
+  for (auto const& p : parameters)
+    append(
+      reply, max, "+%s:%lu\r\n", p.name, static_cast<unsigned long>(p.get()));
+}
+
+/// Compact telemetry, one line per counter group
+void stats(char* reply, size_t max) {
+  auto const s{telemetry_snapshot()};
+  append(reply,
+         max,
+         "+UP:%lld\r\n+U2B:%lu,%lu,%lu\r\n+B2U:%lu,%lu,%lu\r\n",
+         static_cast<long long>(s.uptime_us / 1'000'000),
+         static_cast<unsigned long>(s.uart_to_bt.rx_bytes),
+         static_cast<unsigned long>(s.uart_to_bt.tx_bytes),
+         static_cast<unsigned long>(s.uart_to_bt.rx_stalls),
+         static_cast<unsigned long>(s.bt_to_uart.rx_bytes),
+         static_cast<unsigned long>(s.bt_to_uart.tx_bytes),
+         static_cast<unsigned long>(s.bt_to_uart.tx_stalls));
+  append(reply,
+         max,
+         "+LINK:%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\r\n",
+         static_cast<unsigned long>(s.link_connections),
+         static_cast<unsigned long>(s.link_rx_bytes),
+         static_cast<unsigned long>(s.link_tx_bytes),
+         static_cast<unsigned long>(s.link_retransmits),
+         static_cast<unsigned long>(s.link_lost_frames),
+         static_cast<unsigned long>(s.link_crc_errors),
+         static_cast<unsigned long>(s.link_rewinds),
+         static_cast<unsigned long>(s.link_rx_drops),
+         static_cast<unsigned long>(s.link_throttles));
+  append(reply,
+         max,
+         "+UART:%lu,%lu,%lu,%lu\r\n+HEAP:%lu,%lu\r\n",
+         static_cast<unsigned long>(s.uart_fifo_overflows),
+         static_cast<unsigned long>(s.uart_buffer_full),
+         static_cast<unsigned long>(s.uart_flow_stops),
+         static_cast<unsigned long>(s.baud_rate_changes),
+         static_cast<unsigned long>(s.free_heap),
+         static_cast<unsigned long>(s.min_free_heap));
+  append(reply,
+         max,
+         "+PWR:%lu,%lu,%lu\r\n",
+         static_cast<unsigned long>(s.power_idles),
+         static_cast<unsigned long>(s.power_wakes),
+         static_cast<unsigned long>(s.power_sniffs));
+}
+
+/// Execute AT+TEST=<s>
+///
+/// The self-test only replaces the data of a bridge's data port, a hub has
+/// none to replace. The peer gets asked to run it alongside.
+///
+/// \param  cmd Command after AT+TEST=
+/// \return true if the self-test started
+bool test(char const* cmd) {
+  if (bt_hub || !std::isdigit(static_cast<unsigned char>(*cmd))) return false;
+  char* end;
+  auto const s{std::strtoul(cmd, &end, 10)};
+  if (*end || !s || s > command_selftest_max) return false;
+  selftest_start(static_cast<uint32_t>(s));
+  link_selftest_start(0u, static_cast<uint32_t>(s));
+  bt_tx_wake(0u);
+  return true;
+}
+
+/// Append a self-test report
+///
+/// \param  reply   Reply
+/// \param  max     Size of reply
+/// \param  prefix  Prefix of the line
+/// \param  r       Report
+void report(char* reply, size_t max, char const* prefix, SelftestReport r) {
+  append(reply,
+         max,
+         "%s:%lu,%lu,%lu,%lu,%lu,%lu,%lu\r\n",
+         prefix,
+         static_cast<unsigned long>(r.rx_bytes),
+         static_cast<unsigned long>(r.bit_errors),
+         static_cast<unsigned long>(r.byte_errors),
+         static_cast<unsigned long>(r.lost),
+         static_cast<unsigned long>(r.duplicated),
+         static_cast<unsigned long>(r.tx_retries),
+         static_cast<unsigned long>(r.rx_retries));
+}
+
+/// Execute AT+<NAME>=<value> or AT+<NAME>?
+///
+/// \param  cmd   Command after AT+
+/// \param  reply Reply
+/// \param  max   Size of reply
+/// \return true on success
+bool parameter(char const* cmd, char* reply, size_t max) {
+  for (auto const& p : parameters) {
+    auto const n{std::strlen(p.name)};
+    if (std::strncmp(cmd, p.name, n)) continue;
+    cmd += n;
+
+    // Query
+    if (!std::strcmp(cmd, "?"))
+      return append(
+        reply, max, "+%s:%lu\r\n", p.name, static_cast<unsigned long>(p.get()));
+
+    // Set
+    if (*cmd++ != '=' || !std::isdigit(static_cast<unsigned char>(*cmd)))
+      return false;
+    char* end;
+    auto const v{std::strtoul(cmd, &end, 10)};
+    if (*end || v < p.min || v > p.max) return false;
+    return p.set(static_cast<uint32_t>(v));
+  }
+  return false;
+}
+
+}  // namespace
+
+/// Execute a command line
+///
+/// \param  line  Command line without line end, gets converted to upper case
+/// \param  reply Destination of the reply
+/// \param  max   Size of reply
+/// \return false if the command ends command mode
+bool command_execute(char* line, char* reply, size_t max) {
+  for (auto c{line}; *c; ++c)
+    *c = static_cast<char>(std::toupper(static_cast<unsigned char>(*c)));
+  *reply = '\0';
+
+  if (std::strncmp(line, "AT", 2u)) {
+    append(reply, max, "ERROR\r\n");
+    return true;
+  }
+
+  auto const cmd{line + 2};
+  bool ok{true}, online{};
+  if (!*cmd) {}
+  else if (!std::strcmp(cmd, "O")) online = true;
+  else if (!std::strcmp(cmd, "I"))
+    ok = append(reply,
+                max,
+                "AoiHashi %s\r\n",
+                profile_names[static_cast<size_t>(pipeline_profile)]);
+  else if (!std::strcmp(cmd, "&V")) list(reply, max);
+  else if (!std::strcmp(cmd, "&W")) ok = settings_store();
+  else if (!std::strcmp(cmd, "&F")) settings_defaults();
+  else if (!std::strcmp(cmd, "+STATS")) stats(reply, max);
+  else if (!std::strncmp(cmd, "+TEST=", 6u)) online = ok = test(cmd + 6);
+  else if (*cmd == '+') ok = parameter(cmd + 1, reply, max);
+  else ok = false;
+
+  append(reply, max, ok ? "OK\r\n" : "ERROR\r\n");
+  return !(ok && online);
+}
+
+/// Report the self-test AT+TEST started once it ran out
+///
+/// The own report covers the direction from the peer, the peer's report the
+/// one towards it.
+///
+/// \param  reply Destination of the reply
+/// \param  max   Size of reply
+void command_selftest_report(char* reply, size_t max) {
+  auto const r{selftest_report()};
+  selftest_print(r);
+  *reply = '\0';
+  report(reply, max, "+TEST", r);
+  if (SelftestReport peer; selftest_peer_report(peer)) {
+    selftest_print(peer, "peer");
+    report(reply, max, "+PEERTEST", peer);
+  }
+  append(reply, max, "OK\r\n");
+}
+
+/// Send the report of the self-test the peer started back to it once it ran
+/// out
+void command_selftest_reply() {
+  link_selftest_report(0u);
+  bt_tx_wake(0u);
+}
@@ -0,0 +1,99 @@
+/// Command
+///
+/// Hayes style command mode of the data port. The escape sequence is
+/// command_escape_len times command_escape_char with at least
+/// command_guard_time of silence before and after it and less than that in
+/// between. A binary stream never pauses that long right around three plus
+/// signs, so it can't trigger by accident. The escape characters still get
+/// bridged, just like a modem forwards them.
+///
+/// In command mode every line gets answered with OK or ERROR. Commands are
+/// case insensitive:
+/// - AT        Nothing, answers OK
+/// - ATO       Back to data mode
+/// - ATI       Firmware and profile
+/// - AT&V      Current settings
+/// - AT&W      Store settings in NVS
+/// - AT&F      Restore the profile defaults
+/// - AT+STATS  Telemetry
+/// - AT+TEST=<s> Back to data mode and run the self-test for s seconds on both
+///   bridges, command mode returns with its report (received payload bytes,
+///   bit errors, byte errors, lost frames, duplicated frames, retries towards
+///   the peer and retries from the peer). +TEST covers the direction from the
+///   peer, +PEERTEST the one towards it as the peer checked it. A peer which
+///   can't run the self-test doesn't report.
+/// - AT+<NAME>=<value> or AT+<NAME>? Set or query a setting, <NAME> is one of
+///   BAUD, CHUNK, AGG (0 latency, 1 throughput, 2 adaptive), WINDOW [ms] or
+///   FLOW (0 none, 1 RTS/CTS, 2 XON/XOFF)
+///
+/// \file   command.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "config.hpp"
+
+/// Command escape detector
+///
+/// Plain state without any hardware access, it gets fed with every read of
+/// the data port, including reads which timed out.
+class CommandEscape {
+public:
+  /// Feed a read
+  ///
+  /// \param  data  Data
+  /// \param  len   Length of data, 0 if the read timed out
+  /// \param  now   Time of the read [us]
+  /// \return true once the escape sequence got completed by the guard time
+  constexpr bool operator()(uint8_t const* data, size_t len, int64_t now) {
+    for (size_t j{}; j < len; ++j) {
+      auto const silence{now - last_};
+      if (data[j] == command_escape_char &&
+          (count_ ? count_ < command_escape_len && silence < guard
+                  : silence >= guard))
+        ++count_;
+      else count_ = 0u;
+      last_ = now;
+    }
+    if (count_ < command_escape_len || now - last_ < guard) return false;
+    count_ = 0u;
+    return true;
+  }
+
+  /// Check whether a complete escape sequence waits for its guard time
+  ///
+  /// Reads have to time out meanwhile, only the silence completes it.
+  constexpr bool pending() const { return count_ == command_escape_len; }
+
+private:
+  static constexpr int64_t guard{int64_t{command_guard_time} * 1000};
+
+  int64_t last_{};  ///< Time of the last character
+  size_t count_{};  ///< Escape characters seen so far
+};
+
+/// Execute a command line
+///
+/// Settings get changed right away, it's up to the caller to apply them once
+/// the reply got sent.
+///
+/// \param  line  Command line without line end, gets converted to upper case
+/// \param  reply Destination of the reply
+/// \param  max   Size of reply
+/// \return false if the command ends command mode
+bool command_execute(char* line, char* reply, size_t max);
+
+/// Report the self-test AT+TEST started once it ran out
+///
+/// The report gets printed as well, so does the peer's if it reported.
+///
+/// \param  reply Destination of the reply
+/// \param  max   Size of reply
+void command_selftest_report(char* reply, size_t max);
+
+/// Send the report of the self-test the peer started back to it once it ran
+/// out
+void command_selftest_reply();
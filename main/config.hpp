@@ -8,12 +8,38 @@
 
 #include <driver/gpio.h>
 #include <driver/uart.h>
+#include <esp_spp_api.h>
+#include <freertos/FreeRTOS.h>
+#include <algorithm>
+#include <array>
 
 /// BT device name
 constexpr auto bt_dev_name{"ESP32_BT_UART_BRIDGE"};
 
+/// BT device name of a hub
+constexpr auto bt_hub_dev_name{"ESP32_BT_UART_HUB"};
+
+/// Peers a bridge keeps connected, a bridge with more than one is a hub
+///
+/// A hub is SPP master of up to 7 bridges (the piconet limit) and frames data
+/// on its UARTs (see hub_frame_sync). Bridges which find a hub become its
+/// slave. Every peer costs a BT transmit task, UART channels and link state,
+/// the replay buffer shrinks to fit (see bt_spp_replay_len). The DRAM budget
+/// holds up to 4 peers, 3 with the HighThroughput profile.
+constexpr size_t bt_max_peers{1u};
+static_assert(bt_max_peers >= 1u && bt_max_peers <= 7u,
+              "bt_max_peers must be 1 to 7 (piconet limit)");
+constexpr bool bt_hub{bt_max_peers > 1u};
+
+/// Compress SPP payload if the peer supports it, framing doesn't depend on it
+constexpr auto bt_spp_compression{true};
+
+/// Suffix of the SPP server name which announces the framed link, the hello
+/// tells which capabilities it has
+constexpr auto bt_spp_capability_tag{"+Z"};
+
 /// BT SPP server name
-constexpr auto bt_spp_server_name{"ESP32_BT_UART_SPP_SERVER"};
+constexpr auto bt_spp_server_name{"ESP32_BT_UART_SPP_SERVER+Z"};
 
 /// Tags for logging
 constexpr auto bt_tag{"BT"};
@@ -23,52 +49,440 @@ constexpr auto bt_spp_master_tag{"BT_SPP_MASTER"};
 constexpr auto bt_spp_slave_tag{"BT_SPP_SLAVE"};
 constexpr auto uart_tag{"UART"};
 
+/// NVS namespace
+constexpr auto nvs_namespace{"aoihashi"};
+
+/// Time a peer known from NVS gets to connect before it is forgotten and the
+/// next boot searches for one again [ms]
+constexpr auto bt_peer_timeout{10000};
+
 /// Min and max inquiry duration (for BT discovery a random duration between min
 /// and max is picked)
 constexpr auto inquiry_duration_min{1};
 constexpr auto inquiry_duration_max{5};
 
-/// SPP chunk size
+/// UART chunk aggregation policy
+enum class Aggregation {
+  Latency,     ///< Ship whatever arrived as soon as the driver signals data
+  Throughput,  ///< Fill chunks up to uart_chunk_size or until window elapsed
+  Adaptive,    ///< Switch between both based on the observed arrival rate
+};
+
+/// UART flow control mode
+///
+/// Backpressure towards the host gets asserted once the UART channel fills
+/// up and released again after BT drained it. Backpressure from the host
+/// pauses UART transmission, which in turn holds the peer back once its replay
+/// buffer is full.
+enum class FlowControl {
+  None,      ///< No flow control
+  Hardware,  ///< RTS/CTS (RTS follows the channel fill level)
+  Software,  ///< XON/XOFF (data must not contain XON or XOFF characters)
+};
+
+/// Placement profiles, Bluedroid always runs on PRO_CPU
+///
+/// Compare them by the per-core load telemetry reports, at high baud rates
+/// App tends to saturate APP_CPU while PRO_CPU has headroom.
+enum class PlacementProfile {
+  App,    ///< Pipeline on APP_CPU, PRO_CPU left to Bluedroid
+  Split,  ///< UART tasks on APP_CPU, BT transmit tasks next to Bluedroid
+  Float,  ///< No affinity, the scheduler picks whichever core is free
+};
+
+/// Channel geometry
+struct BufferPolicy {
+  unsigned uart_buf_len;     ///< UART channel length (power of 2)
+  unsigned bt_spp_buf_len;   ///< SPP channel length (power of 2)
+  size_t bt_spp_replay_len;  ///< Frames kept for retransmission (power of 2)
+};
+
+/// Aggregation of UART data into chunks
+struct AggregationPolicy {
+  Aggregation mode;
+  int window;     ///< Aggregation window [ms]
+  int fill_rate;  ///< Rate above which adaptive aggregation fills [bytes/s]
+  int idle_rate;  ///< Rate below which it ships on idle again [bytes/s]
+};
+
+/// Backpressure towards the host
+struct FlowControlPolicy {
+  FlowControl mode;
+  int stop_level;    ///< UART channel fill level which asserts it [%]
+  int resume_level;  ///< UART channel fill level which releases it [%]
+};
+
+/// Policies of a pipeline profile
+struct PipelinePolicies {
+  BufferPolicy buffers;
+  AggregationPolicy aggregation;
+  FlowControlPolicy flow_control;
+  PlacementProfile placement;
+};
+
+/// Pipeline profiles
+///
+/// A profile bundles the policies which suit one kind of line. The build picks
+/// one by AOIHASHI_PROFILE and names the firmware after it (see
+/// CMakeLists.txt), so every line runs the same tree. Chunk sizes and the
+/// compression window are part of the wire format and shared by all profiles,
+/// bridges running different profiles still talk to each other.
+enum class Profile {
+  Default,         ///< Adaptive aggregation, moderate buffers
+  LowLatency,      ///< Ship every burst right away
+  HighThroughput,  ///< Fill chunks, deep buffers, BT next to Bluedroid
+  LowMemory,       ///< Shallow buffers, short replay
+};
+
+#ifndef AOIHASHI_PROFILE
+#  define AOIHASHI_PROFILE Default
+#endif
+constexpr auto pipeline_profile{Profile::AOIHASHI_PROFILE};
+
+/// Policies of the selected profile
+constexpr PipelinePolicies pipeline{[] {
+  PipelinePolicies retval{.buffers = {.uart_buf_len = 4u,
+                                      .bt_spp_buf_len = 4u,
+                                      .bt_spp_replay_len = 16u},
+                          .aggregation = {.mode = Aggregation::Adaptive,
+                                          .window = 10,
+                                          .fill_rate = 8 * 1024,
+                                          .idle_rate = 4 * 1024},
+                          .flow_control = {.mode = FlowControl::None,
+                                           .stop_level = 75,
+                                           .resume_level = 50},
+                          .placement = PlacementProfile::App};
+  switch (pipeline_profile) {
+    case Profile::Default: break;
+    case Profile::LowLatency:
+      retval.aggregation.mode = Aggregation::Latency;
+      retval.aggregation.window = 2;
+      break;
+    case Profile::HighThroughput:
+      retval.buffers = {
+        .uart_buf_len = 8u, .bt_spp_buf_len = 8u, .bt_spp_replay_len = 32u};
+      retval.aggregation.mode = Aggregation::Throughput;
+      retval.aggregation.window = 20;
+      retval.placement = PlacementProfile::Split;
+      break;
+    case Profile::LowMemory:
+      retval.buffers = {
+        .uart_buf_len = 2u, .bt_spp_buf_len = 2u, .bt_spp_replay_len = 4u};
+      break;
+  }
+  return retval;
+}()};
+
+/// SPP chunk size (must hold a chunk of the peer)
 constexpr auto bt_spp_chunk_size{1024};
 
-/// SPP ring buffer length
-constexpr auto bt_spp_buf_len{4};
+/// SPP channel length (power of 2)
+constexpr auto bt_spp_buf_len{pipeline.buffers.bt_spp_buf_len};
+static_assert(bt_spp_buf_len && !(bt_spp_buf_len & (bt_spp_buf_len - 1u)));
+
+/// Time to wait for the peer's hello after the connection opened [ms]
+constexpr auto bt_spp_hello_timeout{1000};
+
+/// Compression window (part of the wire format) [bytes]
+constexpr size_t bt_spp_compression_window{1024u};
+
+/// Time after which received frames get acknowledged if there is no data to
+/// piggyback the acknowledgement on [ms]
+constexpr auto bt_spp_ack_interval{10};
+
+/// Maximum number of SPP writes which haven't completed yet
+constexpr uint32_t bt_spp_max_pending_writes{2u};
+
+/// RFCOMM frame size SPP writes get cut to [bytes]
+///
+/// Bluedroid doesn't report the frame size a connection negotiated, peers
+/// running Bluedroid always end up with ESP_SPP_MAX_MTU. A peer with a smaller
+/// one needs this lowered, larger writes get split into a full frame and a
+/// runt which costs a baseband packet of its own.
+constexpr size_t bt_spp_mtu{ESP_SPP_MAX_MTU};
+
+/// Time without UART or BT traffic after which the link goes idle [ms]
+constexpr uint32_t power_idle_timeout{5000u};
+
+/// Poll interval of an active and of an idle link [625us slots]
+constexpr uint16_t power_active_poll{40u};
+constexpr uint16_t power_idle_poll{160u};
+static_assert(power_active_poll <= power_idle_poll);
+
+/// Let the CPU enter light sleep while idle, UART RX edges wake it up
+///
+/// The UART is clock gated during light sleep, the characters which wake it up
+/// are lost. Needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE.
+constexpr bool power_light_sleep{false};
+
+/// RX edges which wake the CPU from light sleep
+constexpr int power_light_sleep_wake_edges{3};
+
+/// Time the CPU takes to wake up from light sleep [us]
+constexpr uint32_t power_light_sleep_wake_time{1000u};
+
+/// Latency the idle policy adds to the first byte after idle at most [us]
+///
+/// The first frame waits for the next poll of the idle link, plus the wake up
+/// from light sleep.
+constexpr uint32_t power_wake_budget{
+  power_idle_poll * 625u +
+  (power_light_sleep ? power_light_sleep_wake_time : 0u)};
 
-/// SPP ring buffer size
-constexpr auto bt_spp_buf_size{bt_spp_chunk_size * bt_spp_buf_len};
+/// First byte latency after idle the bridge must stay within [us]
+constexpr uint32_t power_wake_spec{150'000u};
+static_assert(power_wake_budget <= power_wake_spec,
+              "Idle policy exceeds the first byte latency spec");
 
-/// UART chunk size
+/// UART chunk size (part of the wire format)
 constexpr auto uart_chunk_size{1024};
+static_assert(uart_chunk_size <= bt_spp_chunk_size,
+              "SPP chunks must hold a chunk of the peer");
 
-/// UART ring buffer length
-constexpr auto uart_buf_len{4};
+/// UART chunk aggregation policy, window [ms] and the arrival rates which
+/// switch adaptive aggregation [bytes/s]
+constexpr auto uart_aggregation{pipeline.aggregation.mode};
+constexpr auto uart_aggregation_window{pipeline.aggregation.window};
+constexpr auto uart_aggregation_fill_rate{pipeline.aggregation.fill_rate};
+constexpr auto uart_aggregation_idle_rate{pipeline.aggregation.idle_rate};
+static_assert(uart_aggregation_window > 0);
+static_assert(uart_aggregation_idle_rate < uart_aggregation_fill_rate);
 
-/// UART ring buffer size
+/// UART backend
+///
+/// The driver moves every byte through the RX and TX interrupts and falls
+/// behind somewhere above 2 MBaud. UHCI streams between the UART FIFOs and
+/// memory by DMA and only interrupts once a descriptor is done, when the line
+/// went idle or the descriptor is full. The ESP32 has two UHCI engines, so
+/// two ports at most.
+enum class UartBackend {
+  Driver,  ///< Interrupt driven UART driver
+  Dma,     ///< UHCI DMA
+};
+constexpr auto uart_backend{UartBackend::Driver};
+
+/// UART DMA receive descriptors per port, each one holds uart_chunk_size
+constexpr size_t uart_dma_rx_descs{4u};
+static_assert(uart_dma_rx_descs >= 2u, "DMA needs a descriptor while RX reads");
+static_assert(uart_chunk_size < 4096, "Descriptors hold at most 4095 bytes");
+
+/// UART driver event queue length
+constexpr auto uart_event_queue_len{16};
+
+/// UART RX FIFO full threshold (data gets moved to the driver buffer once the
+/// FIFO holds that many bytes) [bytes]
+constexpr auto uart_rx_full_thresh{120};
+static_assert(uart_rx_full_thresh > 0 && uart_rx_full_thresh < 128);
+
+/// Longest a continuous stream waits in the RX FIFO, lowers the full threshold
+/// at low baud rates. The line never goes idle within such a stream, so reads
+/// without a timeout depend on the threshold [ms]
+constexpr uint32_t uart_rx_full_time{1u};
+
+/// UART RX timeout (line idle for that long marks the end of a burst, for the
+/// driver as well as for DMA) [character times]
+constexpr auto uart_rx_timeout{3};
+static_assert(uart_rx_timeout > 0 && uart_rx_timeout <= 126);
+
+/// Consecutive agreeing measurements before a new baud rate gets committed
+constexpr uint32_t uart_baud_rate_samples{4u};
+static_assert(uart_baud_rate_samples > 0u);
+
+/// Measurements within that much of the current baud rate count as current [%]
+constexpr uint32_t uart_baud_rate_hysteresis{5u};
+
+/// UART channel length (power of 2)
+///
+/// Together with the UART driver buffer this bounds what gets buffered while
+/// the link reconnects.
+constexpr auto uart_buf_len{pipeline.buffers.uart_buf_len};
+static_assert(uart_buf_len >= 2u, "RX needs a free chunk while BT transmits");
+static_assert(!(uart_buf_len & (uart_buf_len - 1u)));
+
+/// UART driver buffer size
 constexpr auto uart_buf_size{uart_chunk_size * uart_buf_len};
 
-/// BT transmit task priority
-constexpr UBaseType_t task_priority_bt_tx{4};
+/// Priority lane channel length (power of 2)
+constexpr size_t uart_priority_buf_len{2u};
+
+/// Largest chunk the priority lane takes [bytes]
+constexpr size_t uart_priority_chunk_size{64u};
+
+/// Hub UART framing
+///
+/// On the UARTs of a hub every block of data is preceded by a header of sync
+/// byte, peer index and length (little endian). Blocks written to the hub go to
+/// that peer or to all of them (hub_broadcast), blocks read from the hub tell
+/// which peer the data came from.
+constexpr uint8_t hub_frame_sync{0xA5u};
+constexpr uint8_t hub_broadcast{0xFFu};
+constexpr size_t hub_header_size{4u};
+
+/// Self-test frame size (header and PRBS payload) [bytes]
+constexpr size_t selftest_frame_size{256u};
+static_assert(selftest_frame_size > 6u &&
+              selftest_frame_size <= static_cast<size_t>(uart_chunk_size));
+
+/// Placement of a task
+struct TaskPlacement {
+  BaseType_t core;       ///< Core the task is pinned to or tskNO_AFFINITY
+  UBaseType_t priority;  ///< Priority
+  uint32_t stack_size;   ///< Stack size [bytes]
+};
+
+/// Placement of the pipeline tasks
+struct Placement {
+  TaskPlacement uart_rx;  ///< UART receive task of every port (runs commands)
+  TaskPlacement uart_tx;  ///< UART transmit task of every port
+  TaskPlacement bt_tx;    ///< BT transmit task of every peer
+};
 
-/// UART receive task priority
-constexpr UBaseType_t task_priority_uart_rx{6};
+/// Placement profile of the pipeline
+constexpr auto task_placement_profile{pipeline.placement};
 
-/// UART transmit task priority
-constexpr UBaseType_t task_priority_uart_tx{5};
+/// Placement of the selected profile
+constexpr Placement task_placement{[] {
+  Placement retval{.uart_rx = {.core = APP_CPU_NUM,
+                               .priority = 6u,
+                               .stack_size = 3072u},
+                   .uart_tx = {.core = APP_CPU_NUM,
+                               .priority = 5u,
+                               .stack_size = 2048u},
+                   .bt_tx = {.core = APP_CPU_NUM,
+                             .priority = 4u,
+                             .stack_size = 3072u}};
+  switch (task_placement_profile) {
+    case PlacementProfile::App: break;
+    case PlacementProfile::Split: retval.bt_tx.core = PRO_CPU_NUM; break;
+    case PlacementProfile::Float:
+      retval.uart_rx.core = tskNO_AFFINITY;
+      retval.uart_tx.core = tskNO_AFFINITY;
+      retval.bt_tx.core = tskNO_AFFINITY;
+      break;
+  }
+  return retval;
+}()};
 
-/// UART peripheral number
-constexpr auto uart_num{UART_NUM_0};
+/// UART flow control mode and the UART channel fill levels which assert and
+/// release backpressure [%]
+constexpr auto uart_flow_control{pipeline.flow_control.mode};
+constexpr auto uart_flow_stop_level{pipeline.flow_control.stop_level};
+constexpr auto uart_flow_resume_level{pipeline.flow_control.resume_level};
+static_assert(uart_flow_resume_level < uart_flow_stop_level &&
+              uart_flow_stop_level <= 100);
 
-/// UART transmit pin number
-constexpr auto uart_tx_pin{GPIO_NUM_1};
+/// RX FIFO fill level at which the hardware sends XOFF, XON is sent once it
+/// dropped below uart_sw_flow_xon_thresh again (XON/XOFF only) [bytes]
+constexpr uint8_t uart_sw_flow_xoff_thresh{122u};
+constexpr uint8_t uart_sw_flow_xon_thresh{64u};
+static_assert(uart_sw_flow_xon_thresh < uart_sw_flow_xoff_thresh);
 
-/// UART receive pin number
-constexpr auto uart_rx_pin{GPIO_NUM_3};
+/// Guard time of the command escape, the data port must stay silent that long
+/// before and after the escape sequence and its characters must follow each
+/// other within it [ms]
+constexpr uint32_t command_guard_time{1000u};
 
-/// UART request-to-send pin number
-constexpr auto uart_rts_pin{UART_PIN_NO_CHANGE};
+/// Character and length of the command escape sequence
+constexpr uint8_t command_escape_char{'+'};
+constexpr size_t command_escape_len{3u};
 
-/// UART clear-to-send pin number
-constexpr auto uart_cts_pin{UART_PIN_NO_CHANGE};
+/// Maximum length of a command line [bytes]
+constexpr size_t command_line_max{64u};
+
+/// Command mode ends once no command arrived for that long [ms]
+constexpr uint32_t command_timeout{30'000u};
+
+/// uart_tx_task feeds the watchdog at least that often while command mode
+/// holds the data port [ms]
+constexpr uint32_t command_wait_time{1000u};
+
+/// Longest self-test AT+TEST runs [s]
+constexpr uint32_t command_selftest_max{3600u};
+
+/// UART port
+struct UartPort {
+  uart_port_t num;          ///< Peripheral number
+  gpio_num_t tx_pin;        ///< Transmit pin number
+  gpio_num_t rx_pin;        ///< Receive pin number
+  int rts_pin;              ///< Request-to-send pin or UART_PIN_NO_CHANGE
+  int cts_pin;              ///< Clear-to-send pin or UART_PIN_NO_CHANGE
+  uint32_t weight;          ///< Share of the link while several ports have data
+  uint32_t priority_len{};  ///< Chunks up to that long take the priority lane
+  int priority_lead{-1};    ///< Chunks starting with it take the priority lane
+};
+
+/// Bridge the console port next to the data port
+///
+/// Off by default, builds which want it define AOIHASHI_UART_CONSOLE (see
+/// CMakeLists.txt).
+#ifndef AOIHASHI_UART_CONSOLE
+#  define AOIHASHI_UART_CONSOLE 0
+#endif
+constexpr bool uart_console{AOIHASHI_UART_CONSOLE};
+
+/// UART ports multiplexed over one SPP connection
+///
+/// Every port has its own channels, tasks and baud rate detection. The first
+/// one is the only port bridged to peers which don't multiplex, both peers must
+/// list the same ports. On the ESP32-PICO-D4 GPIO6 to GPIO11, GPIO16 and
+/// GPIO17 belong to the embedded flash, the console port uses GPIO25 and
+/// GPIO26 instead. Hardware flow control needs RTS and CTS pins, none are
+/// routed by default.
+///
+/// Chunks picked by priority_len or priority_lead skip the bulk chunks other
+/// ports queued ahead of them on both bridges. They only take the lane while no
+/// bulk data of their own port is queued, the stream of a port never gets
+/// reordered. A port dedicated to control messages sets priority_len to
+/// uart_priority_chunk_size.
+constexpr auto uart_ports{[] {
+  // Data port
+  constexpr UartPort data{.num = UART_NUM_0,
+                          .tx_pin = GPIO_NUM_1,
+                          .rx_pin = GPIO_NUM_3,
+                          .rts_pin = UART_PIN_NO_CHANGE,
+                          .cts_pin = UART_PIN_NO_CHANGE,
+                          .weight = 3u};
+  // Console port
+  constexpr UartPort console{.num = UART_NUM_2,
+                             .tx_pin = GPIO_NUM_25,
+                             .rx_pin = GPIO_NUM_26,
+                             .rts_pin = UART_PIN_NO_CHANGE,
+                             .cts_pin = UART_PIN_NO_CHANGE,
+                             .weight = 1u};
+  if constexpr (uart_console) return std::array{data, console};
+  else return std::array{data};
+}()};
+static_assert(size(uart_ports) && size(uart_ports) <= UART_NUM_MAX);
+static_assert(uart_backend != UartBackend::Dma || size(uart_ports) <= 2u,
+              "Only two UHCI engines");
+static_assert([] {
+  for (auto const& port : uart_ports)
+    if (!port.weight || port.priority_len > uart_priority_chunk_size ||
+        port.priority_lead > 0xFF)
+      return false;
+  return true;
+}());
+
+/// Any port picks chunks for the priority lane
+constexpr bool uart_priority_lane{[] {
+  for (auto const& port : uart_ports)
+    if (port.priority_len || port.priority_lead >= 0) return true;
+  return false;
+}()};
+
+/// Peers with priority lane channels towards SPP, the hub doesn't pick chunks
+constexpr size_t uart_priority_peers{uart_priority_lane && !bt_hub ? 1u : 0u};
+
+/// Check whether a port has RTS and CTS routed
+///
+/// \param  port  UART port
+constexpr bool uart_hw_flow_control(UartPort const& port) {
+  return port.rts_pin != UART_PIN_NO_CHANGE &&
+         port.cts_pin != UART_PIN_NO_CHANGE;
+}
+static_assert(uart_flow_control != FlowControl::Hardware ||
+                uart_hw_flow_control(uart_ports[0u]),
+              "Hardware flow control needs RTS and CTS pins");
 
 /// UART configuration parameters
 constexpr uart_config_t uart_config_default{.baud_rate = 921600,
@@ -76,6 +490,66 @@ constexpr uart_config_t uart_config_default{.baud_rate = 921600,
                                             .parity = UART_PARITY_DISABLE,
                                             .stop_bits = UART_STOP_BITS_1,
                                             .flow_ctrl =
-                                              UART_HW_FLOWCTRL_DISABLE,
+                                              uart_flow_control ==
+                                                  FlowControl::Hardware
+                                                ? UART_HW_FLOWCTRL_CTS
+                                                : UART_HW_FLOWCTRL_DISABLE,
                                             .rx_flow_ctrl_thresh = 0,
-                                            .source_clk = UART_SCLK_DEFAULT};
\ No newline at end of file
+                                            .source_clk = UART_SCLK_DEFAULT};
+
+/// Internal DRAM budgets of the statically allocated state [bytes]
+///
+/// Channels, link state, DMA buffers and task stacks are all static. Every
+/// module checks what it takes against a budget derived from its settings at
+/// compile time, the total must leave the rest of internal DRAM to the BT
+/// controller, Bluedroid and the heap (UART driver, NVS).
+constexpr size_t uart_dram_budget{
+  size(uart_ports) * (task_placement.uart_rx.stack_size +
+                      task_placement.uart_tx.stack_size + 2u * 1024u) +
+  bt_max_peers * size(uart_ports) * uart_buf_len * (uart_chunk_size + 16u) +
+  uart_priority_peers * size(uart_ports) * uart_priority_buf_len *
+    (uart_priority_chunk_size + 16u)};
+constexpr size_t uart_dma_dram_budget{
+  uart_backend == UartBackend::Dma
+    ? size(uart_ports) * (uart_dma_rx_descs * uart_chunk_size + 256u)
+    : 0u};
+constexpr size_t bt_dram_budget{
+  size(uart_ports) *
+    (bt_spp_buf_len * (bt_spp_chunk_size + 16u) +
+     uart_priority_buf_len * (uart_priority_chunk_size + 16u)) +
+  bt_max_peers * (task_placement.bt_tx.stack_size + bt_spp_mtu + 1024u)};
+constexpr size_t dram_budget{128u * 1024u};
+
+/// Link state of a peer with a replay buffer of len frames [bytes]
+///
+/// The 8 frames on top cover the LZSS state, the frame being received and the
+/// chunk it decompresses into.
+constexpr size_t link_dram(size_t len) {
+  return (len + 8u) * (uart_chunk_size + 64u);
+}
+
+/// Frames kept for retransmission until the peer acknowledged them (power of 2)
+///
+/// A hub trades replay depth for peers, the profile's length gets halved until
+/// the link state of all peers fits the DRAM budget. It keeps at least 8 frames
+/// though, with fewer its links wait for acknowledgements while the broadcast
+/// overruns their channels.
+constexpr size_t bt_spp_replay_len{[] {
+  auto len{pipeline.buffers.bt_spp_replay_len};
+  if (!bt_hub) return len;
+  len = std::max<size_t>(len, 8u);
+  while (len > 8u &&
+         uart_dram_budget + uart_dma_dram_budget + bt_dram_budget +
+             bt_max_peers * link_dram(len) >
+           dram_budget)
+    len /= 2u;
+  return len;
+}()};
+
+constexpr size_t link_dram_budget{bt_max_peers *
+                                  link_dram(bt_spp_replay_len)};
+static_assert(uart_dram_budget + uart_dma_dram_budget + bt_dram_budget +
+                  link_dram_budget <=
+                dram_budget,
+              "Static state exceeds the DRAM budget, lower bt_max_peers or "
+              "the buffer lengths of the pipeline profile");
@@ -0,0 +1,953 @@
+/// Link
+///
+/// \file   link.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_log.h>
+#include <esp_random.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include "config.hpp"
+#include "link.hpp"
+#include "lzss.hpp"
+#include "queue.hpp"
+#include "selftest.hpp"
+#include "telemetry.hpp"
+#include "uart.hpp"
+
+static_assert(uart_chunk_size <= bt_spp_chunk_size,
+              "A decompressed frame must fit into a BT channel item");
+static_assert(bt_spp_replay_len && bt_spp_replay_len <= 0x8000u &&
+                !(bt_spp_replay_len & (bt_spp_replay_len - 1u)),
+              "Replay buffer length must be a power of 2");
+
+/// Link mode
+enum class LinkMode : uint8_t { Undecided, Raw, Framed };
+
+/// Frame types
+///
+/// A frame consists of
+/// - type, the upper nibble carries the UART port of a chunk and bit 3 marks
+///   a chunk of the priority lane
+/// - payload length (little endian)
+/// - sequence number (little endian)
+/// - acknowledgement, the sequence number expected next (little endian)
+/// - lower 16 bits of the session the acknowledgement refers to (little
+///   endian)
+/// - payload
+/// - CRC-16/CCITT-FALSE of all of the above (little endian)
+enum FrameType : uint8_t {
+  Raw = 0u,       ///< Chunk
+  Lzss = 1u,      ///< Compressed chunk
+  Ack = 2u,       ///< Acknowledgement only
+  Resume = 3u,    ///< Session received from the peer, resume at acknowledgement
+  Sync = 4u,      ///< Session sent, stream restarts at sequence number
+  Rewind = 5u,    ///< Chunks got dropped, send again from acknowledgement on
+  Selftest = 6u,  ///< Self-test start or report, see SelftestOp
+};
+
+/// Self-test frames, the first payload byte tells which one and an id of the
+/// start follows
+/// - Start carries the duration [s]
+/// - Report answers the start of the id and carries the elapsed time [us] and
+///   the fields of report_fields
+///
+/// Neither one has a sequence number, so both get sent again after every
+/// reconnect until they're stale. The id tells a start which got sent again
+/// from a new one and a report of an earlier start from the one awaited.
+enum class SelftestOp : uint8_t { Start, Report };
+
+/// Capability bits carried by the hello
+constexpr uint8_t link_cap_lzss{1u << 0u};
+constexpr uint8_t link_cap_replay{1u << 1u};
+constexpr uint8_t link_cap_mux{1u << 2u};
+constexpr uint8_t link_cap_priority{1u << 3u};
+constexpr uint8_t link_cap_rewind{1u << 4u};
+constexpr uint8_t link_cap_selftest{1u << 5u};
+
+/// Capabilities a peer must have to frame the link
+constexpr uint8_t link_caps_required{link_cap_replay};
+
+/// Own capabilities, peers ignore bits they don't know. Compression only gets
+/// announced if bt_spp_compression is set, multiplexing only by builds with
+/// several ports and the self-test only by bridges, a hub doesn't run it.
+/// Marked priority chunks get taken by every build whether it picks chunks for
+/// the lane itself or not.
+constexpr uint8_t link_caps{link_caps_required | link_cap_priority |
+                            link_cap_rewind |
+                            (bt_spp_compression ? link_cap_lzss : 0u) |
+                            (size(uart_ports) > 1u ? link_cap_mux : 0u) |
+                            (bt_hub ? 0u : link_cap_selftest)};
+
+/// Hello, the last byte carries the capabilities
+static constexpr uint8_t hello[]{
+  0xA0u, 0x1Bu, 'A', 'o', 'i', 'H', 'a', 's', 'h', 'i', '/', 'l', 'i', 'n', 'k',
+  link_caps};
+
+/// Port of a chunk in the upper nibble of the frame type
+constexpr uint8_t link_type_mask{0x07u};
+constexpr uint8_t link_type_priority{0x08u};
+constexpr uint8_t link_port_shift{4u};
+
+/// Replay buffer slots bulk chunks leave to the priority lane
+constexpr size_t link_priority_reserve{uart_priority_peers ? 1u : 0u};
+static_assert(link_priority_reserve < bt_spp_replay_len);
+static_assert(size(uart_ports) <= (0xFFu >> link_port_shift) + 1u);
+
+/// Fields a self-test report frame carries after the elapsed time [us]
+static constexpr uint32_t SelftestReport::* report_fields[]{
+  &SelftestReport::tx_frames,
+  &SelftestReport::rx_frames,
+  &SelftestReport::rx_bytes,
+  &SelftestReport::bit_errors,
+  &SelftestReport::byte_errors,
+  &SelftestReport::lost,
+  &SelftestReport::duplicated,
+  &SelftestReport::resyncs,
+  &SelftestReport::tx_retries,
+  &SelftestReport::rx_retries};
+static_assert(uint64_t{command_selftest_max} * 1'000'000u <= UINT32_MAX,
+              "Elapsed time of a self-test report must fit into 32 bits");
+
+/// Payload size of self-test frames
+constexpr size_t link_selftest_start_size{1u + 4u + 4u};
+constexpr size_t link_selftest_report_size{1u + 4u + 4u +
+                                           4u * std::size(report_fields)};
+
+/// CRC-16/CCITT-FALSE lookup table
+static constexpr auto crc_table{[] {
+  std::array<uint16_t, 256u> retval{};
+  for (uint32_t i{}; i < size(retval); ++i) {
+    auto crc{static_cast<uint16_t>(i << 8u)};
+    for (auto j{0u}; j < 8u; ++j)
+      crc = static_cast<uint16_t>(crc & 0x8000u ? (crc << 1u) ^ 0x1021u
+                                                : crc << 1u);
+    retval[i] = crc;
+  }
+  return retval;
+}()};
+
+/// Frame in the replay buffer
+struct Slot {
+  size_t len;
+  uint8_t data[link_max_frame_size];
+};
+
+/// Link to a single peer
+struct Link {
+  // Connection state
+  std::atomic<LinkMode> mode{LinkMode::Undecided};
+  std::atomic<TaskHandle_t> waiter{nullptr};
+  std::atomic<bool> opened{};
+  bool hello_first{};
+
+  // Transmit state, only touched by bt_tx_task except for acknowledgements
+  uint32_t tx_session{};
+  std::atomic<uint16_t> tx_seq{};    ///< Sequence number of next frame
+  std::atomic<uint16_t> tx_acked{};  ///< Oldest unacknowledged frame
+  uint16_t tx_retransmit{};          ///< Next frame to send again
+  bool tx_sync{};                    ///< Sync frame is due
+  std::atomic<bool> tx_rewind{};     ///< Peer asked to send again
+  // Self-test the peer got asked to run and the report of the one it asked
+  // for, both get sent again on every connection
+  std::atomic<uint32_t> tx_selftest_s{};  ///< Duration [s], 0 if none
+  std::atomic<uint32_t> tx_selftest_id{};
+  std::atomic<bool> tx_start_due{};
+  std::array<uint8_t, link_selftest_report_size> tx_report{};
+  std::atomic<bool> tx_report_ready{};
+  std::atomic<bool> tx_report_due{};
+  uint16_t ack_sent{};
+  std::array<Slot, bt_spp_replay_len> replay{};
+  uint8_t control[link_header_size + link_selftest_report_size +
+                  link_trailer_size];
+  lzss::Compressor<bt_spp_compression_window, uart_chunk_size> compressor;
+
+  // Receive state, only touched by the SPP callback except for session and
+  // expected sequence number
+  std::atomic<uint32_t> rx_session{};
+  std::atomic<uint16_t> rx_expected{};
+  lzss::Decompressor<bt_spp_compression_window, uart_chunk_size> decompressor;
+  uint8_t rx_decoded[uart_chunk_size];  ///< Decompressed chunk
+  bool rx_decided{};
+  bool rx_framed{};
+  bool rx_failed{};
+  size_t rx_hello{};
+  std::atomic<uint8_t> rx_caps{};
+  uint8_t rx_frame[link_max_frame_size];  ///< Held back data of a raw link
+  size_t rx_fill{};
+  size_t rx_held{};
+
+  // Chunks dropped because their channel was full, frames after one get
+  // ignored until the peer sent it again
+  bool rx_behind{};
+  std::atomic<uint32_t> rx_drops{};     ///< Drops, bumped by the SPP callback
+  std::atomic<uint32_t> rx_rewound{};   ///< Drops the peer got asked about
+  std::atomic<size_t> rx_drop_port{};   ///< Channel of the last drop
+  std::atomic<bool> rx_drop_lane{};
+
+  // Id of the peer's last self-test start
+  std::atomic<uint32_t> rx_selftest_id{};
+
+  // Resume frame of the peer
+  std::atomic<bool> peer_resumed{};
+  uint32_t peer_session{};
+  uint16_t peer_expected{};
+};
+
+/// Links of all peers
+static std::array<Link, bt_max_peers> links;
+static_assert(sizeof(links) <= link_dram_budget,
+              "Link exceeds its DRAM budget");
+
+static uint16_t crc16(uint8_t const* data, size_t len) {
+  uint16_t crc{0xFFFFu};
+  for (size_t i{}; i < len; ++i)
+    crc = static_cast<uint16_t>((crc << 8u) ^
+                                crc_table[(crc >> 8u) ^ data[i]]);
+  return crc;
+}
+
+static uint16_t get16(uint8_t const* p) {
+  return static_cast<uint16_t>(p[0u] | (p[1u] << 8u));
+}
+
+static uint32_t get32(uint8_t const* p) {
+  return get16(p) | static_cast<uint32_t>(get16(p + 2u)) << 16u;
+}
+
+static void put16(uint8_t* p, uint16_t value) {
+  p[0u] = static_cast<uint8_t>(value);
+  p[1u] = static_cast<uint8_t>(value >> 8u);
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+  put16(p, static_cast<uint16_t>(value));
+  put16(p + 2u, static_cast<uint16_t>(value >> 16u));
+}
+
+/// Wake up bt_tx_task if it waits in a link function
+///
+/// \param  l Link
+static void wake(Link& l) {
+  if (auto const task{l.waiter.exchange(nullptr)}) xTaskNotifyGive(task);
+}
+
+/// Wait until ready returns true, the connection closed or ticks elapsed
+///
+/// \param  l     Link
+/// \param  ticks Ticks to wait
+/// \param  ready Condition
+/// \return Result of ready
+template<typename F>
+static bool wait(Link& l, TickType_t ticks, F&& ready) {
+  auto const start{xTaskGetTickCount()};
+  for (;;) {
+    l.waiter = xTaskGetCurrentTaskHandle();
+    auto const elapsed{xTaskGetTickCount() - start};
+    if (ready() || !l.opened || elapsed >= ticks) {
+      l.waiter = nullptr;
+      return ready();
+    }
+    ulTaskNotifyTake(pdTRUE, ticks - elapsed);
+  }
+}
+
+/// Decide link mode, the first decision wins
+///
+/// \param  l   Link
+/// \param  to  Mode
+/// \return Decided mode
+static LinkMode decide(Link& l, LinkMode to) {
+  auto from{LinkMode::Undecided};
+  if (!l.mode.compare_exchange_strong(from, to)) return from;
+  wake(l);
+  return to;
+}
+
+/// Fill in header and CRC of a frame whose payload is in place
+///
+/// \param  l     Link
+/// \param  frame Frame
+/// \param  type  Frame type
+/// \param  len   Length of payload
+/// \param  seq       Sequence number
+/// \param  port      UART port of a chunk
+/// \param  priority  Chunk of the priority lane
+/// \return Length of frame
+static size_t seal(Link& l,
+                   uint8_t* frame,
+                   FrameType type,
+                   size_t len,
+                   uint16_t seq,
+                   size_t port = 0u,
+                   bool priority = false) {
+  auto const ack{l.rx_expected.load()};
+  frame[0u] = static_cast<uint8_t>(type | port << link_port_shift |
+                                   (priority ? link_type_priority : 0u));
+  put16(&frame[1u], static_cast<uint16_t>(len));
+  put16(&frame[3u], seq);
+  put16(&frame[5u], ack);
+  put16(&frame[7u], static_cast<uint16_t>(l.rx_session.load()));
+  l.ack_sent = ack;
+  auto const n{link_header_size + len};
+  put16(&frame[n], crc16(frame, n));
+  return n + link_trailer_size;
+}
+
+/// Release frames the peer acknowledged from the replay buffer
+///
+/// \param  l   Link
+/// \param  ack Sequence number the peer expects next
+static void acknowledge(Link& l, uint16_t ack) {
+  auto acked{l.tx_acked.load()};
+  do {
+    auto const ahead{static_cast<uint16_t>(ack - acked)};
+    if (!ahead || ahead > static_cast<uint16_t>(l.tx_seq.load() - acked))
+      return;
+  } while (!l.tx_acked.compare_exchange_weak(acked, ack));
+  wake(l);
+}
+
+/// Copy data into BT channel items
+///
+/// Data is copied into free channel items, which wakes uart_tx_task. This
+/// never waits, the SPP callback runs in Bluedroid's BTC task which serves
+/// every connection and event. Ports and peers share it, a port whose UART
+/// can't keep up must not hold up the others.
+///
+/// \param  channel Channel
+/// \param  peer    Peer index
+/// \param  data    Data
+/// \param  len     Length of data
+/// \return Number of bytes copied, less than len once the channel is full
+template<typename C>
+static size_t push(C& channel, size_t peer, uint8_t const* data, size_t len) {
+  constexpr auto max{C::max_item()};
+  for (size_t i{}; i < len; i += max) {
+    auto const n{std::min<size_t>(len - i, max)};
+    auto const item{channel.acquire(0)};
+    if (!item) {
+      telemetry.bt_to_uart.rx_stalls.fetch_add(1u, std::memory_order_relaxed);
+      return i;
+    }
+
+    item->len = n;
+    item->stamp = telemetry_stamp();
+    item->tag = static_cast<uint32_t>(peer);
+    std::memcpy(item->data, data + i, n);
+    telemetry.bt_to_uart.rx_bytes.fetch_add(n, std::memory_order_relaxed);
+    telemetry.bt_to_uart.size.add(n);
+    channel.commit();
+  }
+  return len;
+}
+
+/// Check whether data takes the priority lane
+///
+/// Only while the bulk channel of the port is empty, including the item
+/// uart_tx_task writes. A chunk which overtook bulk data would reorder the
+/// stream of the port.
+///
+/// \param  port      UART port
+/// \param  len       Length of data
+/// \param  priority  Chunk of the priority lane
+static bool lane(size_t port, size_t len, bool priority) {
+  return priority && len <= uart_priority_chunk_size &&
+         !bt_channels[port].size();
+}
+
+/// Check whether data fits into the BT channel of a port as a whole
+///
+/// Only the SPP callback fills the channels, room can only grow meanwhile.
+///
+/// \param  port      UART port
+/// \param  len       Length of data
+/// \param  priority  Data takes the priority lane
+/// \return true if len bytes fit
+static bool room(size_t port, size_t len, bool priority) {
+  auto const fits{[len](auto const& channel) {
+    auto const max{channel.max_item()};
+    return channel.capacity() - channel.size() >= (len + max - 1u) / max;
+  }};
+  return priority ? fits(bt_priority_channels[port]) : fits(bt_channels[port]);
+}
+
+/// Copy data into the BT channel of a port, or its priority lane
+///
+/// \param  peer      Peer index
+/// \param  port      UART port
+/// \param  data      Data
+/// \param  len       Length of data
+/// \param  priority  Data takes the priority lane
+/// \return Number of bytes copied
+static size_t push(size_t peer,
+                   size_t port,
+                   uint8_t const* data,
+                   size_t len,
+                   bool priority = false) {
+  return priority ? push(bt_priority_channels[port], peer, data, len)
+                  : push(bt_channels[port], peer, data, len);
+}
+
+/// Drop the connection, the stream resumes once it got reopened
+///
+/// \param  l       Link
+/// \param  handle  BT connection handle
+/// \param  reason  Reason for logging
+static void fail(Link& l, uint32_t handle, char const* reason) {
+  ESP_LOGE(bt_spp_tag, "%s %s", __func__, reason);
+  l.rx_failed = true;
+  esp_spp_disconnect(handle);
+}
+
+/// Hold back data of a raw link until the connection reopened
+///
+/// Whatever exceeds the frame buffer is lost, like data on the air of a
+/// dropped connection.
+///
+/// \param  l     Link
+/// \param  data  Data
+/// \param  len   Length of data
+static void hold(Link& l, uint8_t const* data, size_t len) {
+  auto const n{std::min(len, sizeof(l.rx_frame) - l.rx_held)};
+  std::memcpy(&l.rx_frame[l.rx_held], data, n);
+  l.rx_held += n;
+  if (n < len)
+    telemetry.link_rx_drops.fetch_add(len - n, std::memory_order_relaxed);
+}
+
+/// Copy data of a raw link into the BT channel of the first port
+///
+/// A raw link can't get data sent again. Data which doesn't fit gets held back
+/// and the connection dropped, which stops the peer until it reconnected. The
+/// held back data goes first once the connection reopened.
+///
+/// \param  l       Link
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \param  data    Data
+/// \param  len     Length of data
+static void push_raw(Link& l,
+                     size_t peer,
+                     uint32_t handle,
+                     uint8_t const* data,
+                     size_t len) {
+  if (!l.rx_held && room(0u, len, false)) {
+    push(peer, 0u, data, len);
+    return;
+  }
+  hold(l, data, len);
+  if (l.rx_failed) return;
+  telemetry.link_throttles.fetch_add(1u, std::memory_order_relaxed);
+  fail(l, handle, "BT channel full");
+}
+
+/// Drop a chunk whose channel is full
+///
+/// Frames after it get ignored until the peer sent it again, bt_tx_task asks
+/// for that once the channel has room. A peer which can't be asked resumes
+/// after a reconnect.
+///
+/// \param  l       Link
+/// \param  handle  BT connection handle
+/// \param  port    UART port
+/// \param  lane    Chunk took the priority lane
+static void drop(Link& l, uint32_t handle, size_t port, bool lane) {
+  telemetry.link_rewinds.fetch_add(1u, std::memory_order_relaxed);
+  if (!(l.rx_caps & link_caps & link_cap_rewind))
+    return fail(l, handle, "BT channel full");
+  l.rx_behind = true;
+  l.rx_drop_port = port;
+  l.rx_drop_lane = lane;
+  ++l.rx_drops;
+}
+
+/// Handle a chunk
+///
+/// Chunks of ports this side doesn't have still go through the decompressor,
+/// its history must follow the peer's. A chunk only becomes part of the history
+/// and gets acknowledged once it found room in its channel.
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \param  type      Frame type
+/// \param  port      UART port
+/// \param  priority  Chunk of the priority lane
+/// \param  seq       Sequence number
+/// \param  payload   Payload
+/// \param  len       Length of payload
+static void receive_chunk(size_t peer,
+                          uint32_t handle,
+                          uint8_t type,
+                          size_t port,
+                          bool priority,
+                          uint16_t seq,
+                          uint8_t const* payload,
+                          size_t len) {
+  auto& l{links[peer]};
+
+  // Frames before the expected one got sent again, frames after it mean
+  // something got lost
+  auto const expected{l.rx_expected.load()};
+  if (seq != expected) {
+    if (static_cast<int16_t>(seq - expected) > 0 && !l.rx_behind)
+      fail(l, handle, "frame missing");
+    return;
+  }
+
+  uint8_t const* data{payload};
+  size_t n{len};
+  if (type == FrameType::Lzss) {
+    auto const ret{l.decompressor.decode(payload, len, l.rx_decoded)};
+    if (ret < 0) return fail(l, handle, "corrupt frame");
+    data = l.rx_decoded;
+    n = static_cast<size_t>(ret);
+  }
+
+  // Channel is full, the peer has to send the frame again
+  if (port < size(uart_ports)) {
+    auto const fast{lane(port, n, priority)};
+    if (!room(port, n, fast)) return drop(l, handle, port, fast);
+    push(peer, port, data, n, fast);
+  }
+
+  if (type == FrameType::Lzss) l.decompressor.accept();
+  else l.decompressor.raw(payload, len);
+  l.rx_behind = false;
+  l.rx_expected = static_cast<uint16_t>(seq + 1u);
+}
+
+/// Handle a self-test frame
+///
+/// A self-test the peer started replaces the UART data right away, a read of
+/// the data port waiting for data gets woken up. A start which got sent again
+/// gets ignored.
+///
+/// \param  l       Link
+/// \param  payload Payload
+/// \param  len     Length of payload
+/// \return false if the frame is invalid
+static bool receive_selftest(Link& l, uint8_t const* payload, size_t len) {
+  auto const op{static_cast<SelftestOp>(payload[0u])};
+  auto const id{get32(&payload[1u])};
+  if (len == link_selftest_start_size && op == SelftestOp::Start) {
+    if (l.rx_selftest_id.exchange(id) == id) return true;
+    l.tx_report_ready = false;
+    if (selftest_start_by_peer(get32(&payload[5u]))) uart_rx_wake(0u);
+    return true;
+  }
+  if (len != link_selftest_report_size || op != SelftestOp::Report)
+    return false;
+  if (id != l.tx_selftest_id.load()) return true;
+  SelftestReport report{};
+  report.elapsed_us = get32(&payload[5u]);
+  for (size_t i{}; i < std::size(report_fields); ++i)
+    report.*report_fields[i] = get32(&payload[9u + 4u * i]);
+  selftest_peer_done(report);
+  return true;
+}
+
+/// Handle a complete frame
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+static void receive_frame(size_t peer, uint32_t handle) {
+  auto& l{links[peer]};
+  auto const n{l.rx_fill - link_trailer_size};
+  if (get16(&l.rx_frame[n]) != crc16(l.rx_frame, n)) {
+    telemetry.link_crc_errors.fetch_add(1u, std::memory_order_relaxed);
+    return fail(l, handle, "CRC mismatch");
+  }
+
+  auto const type{static_cast<uint8_t>(l.rx_frame[0u] & link_type_mask)};
+  auto const port{static_cast<size_t>(l.rx_frame[0u] >> link_port_shift)};
+  bool const priority{(l.rx_frame[0u] & link_type_priority) != 0u};
+  auto const len{get16(&l.rx_frame[1u])};
+  auto const seq{get16(&l.rx_frame[3u])};
+  auto const ack{get16(&l.rx_frame[5u])};
+  auto const payload{&l.rx_frame[link_header_size]};
+  bool const current{get16(&l.rx_frame[7u]) ==
+                     static_cast<uint16_t>(l.tx_session)};
+  if (current) acknowledge(l, ack);
+
+  switch (type) {
+    case FrameType::Ack: break;
+
+    case FrameType::Resume:
+      if (len != 4u) return fail(l, handle, "invalid resume frame");
+      l.peer_session = get32(payload);
+      l.peer_expected = ack;
+      l.peer_resumed = true;
+      wake(l);
+      break;
+
+    case FrameType::Sync:
+      if (len != 4u) return fail(l, handle, "invalid sync frame");
+      l.rx_session = get32(payload);
+      l.rx_expected = seq;
+      l.rx_behind = false;
+      l.decompressor.reset();
+      break;
+
+    case FrameType::Rewind:
+      if (!current) break;
+      l.tx_rewind = true;
+      wake(l);
+      break;
+
+    case FrameType::Selftest:
+      if (!(link_caps & link_cap_selftest) ||
+          !receive_selftest(l, payload, len))
+        return fail(l, handle, "invalid self-test frame");
+      break;
+
+    default:
+      receive_chunk(peer, handle, type, port, priority, seq, payload, len);
+      break;
+  }
+}
+
+/// Size of the frame whose header got received
+///
+/// \param  l Link
+static size_t frame_size(Link const& l) {
+  return link_header_size + get16(&l.rx_frame[1u]) + link_trailer_size;
+}
+
+/// Reassemble frames
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \param  data    Data
+/// \param  len     Length of data
+static void
+deframe(size_t peer, uint32_t handle, uint8_t const* data, size_t len) {
+  auto& l{links[peer]};
+  while (len && !l.rx_failed) {
+    // Header first, then as much payload as it announced
+    auto const want{l.rx_fill < link_header_size ? link_header_size
+                                                 : frame_size(l)};
+    auto const n{std::min(len, want - l.rx_fill)};
+    std::memcpy(&l.rx_frame[l.rx_fill], data, n);
+    l.rx_fill += n;
+    data += n;
+    len -= n;
+    if (l.rx_fill < link_header_size) continue;
+
+    if (l.rx_fill == link_header_size &&
+        ((l.rx_frame[0u] & link_type_mask) > FrameType::Selftest ||
+         frame_size(l) > link_max_frame_size))
+      return fail(l, handle, "invalid frame header");
+
+    if (l.rx_fill == frame_size(l)) {
+      receive_frame(peer, handle);
+      l.rx_fill = 0u;
+    }
+  }
+}
+
+void link_open(size_t peer,
+               uint32_t handle,
+               esp_spp_role_t role,
+               bool peer_capable) {
+  auto& l{links[peer]};
+  if (!l.tx_session) l.tx_session = esp_random() | 1u;
+  l.hello_first = role == ESP_SPP_ROLE_MASTER && peer_capable;
+  l.mode = role == ESP_SPP_ROLE_MASTER && !peer_capable ? LinkMode::Raw
+                                                        : LinkMode::Undecided;
+  l.rx_decided = false;
+  l.rx_framed = false;
+  l.rx_failed = false;
+  l.rx_hello = 0u;
+  l.rx_caps = 0u;
+  l.rx_fill = 0u;
+  l.rx_behind = false;
+  l.rx_rewound = l.rx_drops.load();
+  l.tx_rewind = false;
+  l.tx_start_due = l.tx_selftest_s.load() != 0u;
+  l.tx_report_due = l.tx_report_ready.load();
+  l.peer_resumed = false;
+  l.opened = true;
+
+  // Data a raw link held back goes first, only the channel drains meanwhile.
+  // The connection gets dropped again while it still doesn't fit.
+  if (!l.rx_held) return;
+  if (!room(0u, l.rx_held, false)) return fail(l, handle, "BT channel full");
+  push(peer, 0u, l.rx_frame, l.rx_held);
+  l.rx_held = 0u;
+}
+
+void link_close(size_t peer) {
+  auto& l{links[peer]};
+  l.opened = false;
+  wake(l);
+}
+
+uint8_t const* link_hello(size_t& len) {
+  len = sizeof(hello);
+  return hello;
+}
+
+bool link_hello_first(size_t peer) { return links[peer].hello_first; }
+
+size_t link_ports(size_t peer) {
+  auto const& l{links[peer]};
+  return l.mode.load() == LinkMode::Framed &&
+             (l.rx_caps & link_caps & link_cap_mux)
+           ? size(uart_ports)
+           : 1u;
+}
+
+bool link_wait(size_t peer) {
+  auto& l{links[peer]};
+  if (!wait(l, pdMS_TO_TICKS(bt_spp_hello_timeout), [&l] {
+        return l.mode.load() != LinkMode::Undecided;
+      }))
+    decide(l, LinkMode::Raw);
+  return l.mode.load() == LinkMode::Framed;
+}
+
+uint8_t const* link_resume(size_t peer, size_t& len) {
+  auto& l{links[peer]};
+  put32(&l.control[link_header_size], l.rx_session.load());
+  len = seal(l, l.control, FrameType::Resume, 4u, 0u);
+  return l.control;
+}
+
+bool link_wait_resume(size_t peer) {
+  auto& l{links[peer]};
+  if (!wait(l, pdMS_TO_TICKS(bt_spp_hello_timeout), [&l] {
+        return l.peer_resumed.load();
+      }))
+    return false;
+
+  // Resume if the peer still follows this stream and the frames it misses
+  // are still around
+  auto const acked{l.tx_acked.load()};
+  auto const seq{l.tx_seq.load()};
+  if (l.peer_session == l.tx_session &&
+      static_cast<uint16_t>(l.peer_expected - acked) <=
+        static_cast<uint16_t>(seq - acked)) {
+    acknowledge(l, l.peer_expected);
+    l.tx_retransmit = l.tx_acked.load();
+    return true;
+  }
+
+  // Otherwise restart it
+  if (auto const lost{static_cast<uint16_t>(seq - acked)}) {
+    ESP_LOGW(bt_spp_tag, "%s %u frames lost", __func__, lost);
+    telemetry.link_lost_frames.fetch_add(lost, std::memory_order_relaxed);
+  }
+  l.tx_acked = seq;
+  l.tx_retransmit = seq;
+  l.tx_sync = true;
+  l.compressor.reset();
+  return true;
+}
+
+uint8_t const* link_retransmit(size_t peer, size_t& len) {
+  auto& l{links[peer]};
+  if (l.tx_sync) {
+    l.tx_sync = false;
+    put32(&l.control[link_header_size], l.tx_session);
+    len = seal(l, l.control, FrameType::Sync, 4u, l.tx_seq.load());
+    return l.control;
+  }
+
+  // Skip frames which got acknowledged in the meantime
+  auto const acked{l.tx_acked.load()};
+  if (static_cast<int16_t>(l.tx_retransmit - acked) < 0)
+    l.tx_retransmit = acked;
+  if (l.tx_retransmit == l.tx_seq.load()) return nullptr;
+
+  auto const& slot{l.replay[l.tx_retransmit++ & (bt_spp_replay_len - 1u)]};
+  telemetry.link_retransmits.fetch_add(1u, std::memory_order_relaxed);
+  len = slot.len;
+  return slot.data;
+}
+
+bool link_replay_full(size_t peer, bool priority) {
+  auto const& l{links[peer]};
+  return static_cast<uint16_t>(l.tx_seq.load() - l.tx_acked.load()) >=
+         bt_spp_replay_len - (priority ? 0u : link_priority_reserve);
+}
+
+void link_wait_replay(size_t peer, TickType_t ticks) {
+  auto const& l{links[peer]};
+  wait(links[peer], ticks, [peer, &l] {
+    return !link_replay_full(peer) || l.tx_rewind.load();
+  });
+}
+
+uint8_t const* link_rewind_request(size_t peer, size_t& len) {
+  auto& l{links[peer]};
+  auto const drops{l.rx_drops.load()};
+  if (drops == l.rx_rewound.load()) return nullptr;
+
+  // Only once the channel has room for a whole chunk again, or it gets dropped
+  // again
+  if (!room(l.rx_drop_port,
+            l.rx_drop_lane ? uart_priority_chunk_size : uart_chunk_size,
+            l.rx_drop_lane))
+    return nullptr;
+
+  l.rx_rewound = drops;
+  len = seal(l, l.control, FrameType::Rewind, 0u, 0u);
+  return l.control;
+}
+
+bool link_rewind(size_t peer) {
+  auto& l{links[peer]};
+  if (!l.tx_rewind.exchange(false)) return false;
+  l.tx_retransmit = l.tx_acked.load();
+  return true;
+}
+
+uint8_t const* link_encode(size_t peer,
+                           size_t port,
+                           uint8_t const* data,
+                           size_t len,
+                           size_t& frame_len,
+                           bool priority) {
+  auto& l{links[peer]};
+  auto const seq{l.tx_seq.load()};
+  auto& slot{l.replay[seq & (bt_spp_replay_len - 1u)]};
+  auto const payload{&slot.data[link_header_size]};
+  size_t n{};
+  if (l.rx_caps & link_caps & link_cap_lzss)
+    n = l.compressor(data, len, payload, len ? len - 1u : 0u);
+  auto type{FrameType::Lzss};
+  if (!n) {
+    std::memcpy(payload, data, len);
+    n = len;
+    type = FrameType::Raw;
+  }
+  slot.len = seal(l,
+                  slot.data,
+                  type,
+                  n,
+                  seq,
+                  port,
+                  priority && (l.rx_caps & link_caps & link_cap_priority));
+  l.tx_seq = static_cast<uint16_t>(seq + 1u);
+  frame_len = slot.len;
+  return slot.data;
+}
+
+uint8_t const* link_ack(size_t peer, size_t& len) {
+  auto& l{links[peer]};
+  if (l.rx_expected.load() == l.ack_sent) return nullptr;
+  len = seal(l, l.control, FrameType::Ack, 0u, 0u);
+  return l.control;
+}
+
+void link_selftest_start(size_t peer, uint32_t s) {
+  auto& l{links[peer]};
+  if (!(link_caps & link_cap_selftest) || l.mode.load() == LinkMode::Raw)
+    return;
+  selftest_expect_peer();
+  l.tx_selftest_id = esp_random() | 1u;
+  l.tx_selftest_s = s;
+  l.tx_start_due = true;
+}
+
+void link_selftest_report(size_t peer) {
+  auto& l{links[peer]};
+  auto const report{selftest_report()};
+  l.tx_report_ready = false;
+  auto const p{data(l.tx_report)};
+  p[0u] = static_cast<uint8_t>(SelftestOp::Report);
+  put32(&p[1u], l.rx_selftest_id.load());
+  put32(&p[5u], static_cast<uint32_t>(report.elapsed_us));
+  for (size_t i{}; i < std::size(report_fields); ++i)
+    put32(&p[9u + 4u * i], report.*report_fields[i]);
+  l.tx_report_ready = true;
+  l.tx_report_due = true;
+}
+
+uint8_t const* link_selftest(size_t peer, size_t& len) {
+  auto& l{links[peer]};
+  auto const payload{&l.control[link_header_size]};
+
+  // Start only while the own self-test runs and if the peer announced it
+  if (l.tx_start_due.exchange(false)) {
+    if (!selftest_active()) l.tx_selftest_s = 0u;
+    else if (!(l.rx_caps & link_caps & link_cap_selftest)) {
+      l.tx_selftest_s = 0u;
+      selftest_expect_peer(false);
+    } else {
+      payload[0u] = static_cast<uint8_t>(SelftestOp::Start);
+      put32(&payload[1u], l.tx_selftest_id.load());
+      put32(&payload[5u], l.tx_selftest_s.load());
+      len = seal(
+        l, l.control, FrameType::Selftest, link_selftest_start_size, 0u);
+      return l.control;
+    }
+  }
+
+  if (!l.tx_report_due.exchange(false)) return nullptr;
+  std::memcpy(payload, data(l.tx_report), size(l.tx_report));
+  len = seal(l, l.control, FrameType::Selftest, size(l.tx_report), 0u);
+  return l.control;
+}
+
+bool link_settled(size_t peer) {
+  auto const& l{links[peer]};
+  return l.rx_expected.load() == l.ack_sent &&
+         l.rx_drops.load() == l.rx_rewound.load() && !l.tx_rewind.load() &&
+         !l.tx_start_due.load() && !l.tx_report_due.load();
+}
+
+/// Handle received data (SPP callback)
+///
+/// Runs in the Bluedroid BTC task and must not hold up other events, so it
+/// never waits for a free BT channel item. Framed links drop a chunk which
+/// doesn't fit and have the peer send it again, the replay buffer throttles
+/// the peer. Raw links hold it back and drop the connection instead.
+void link_receive(size_t peer,
+                  uint32_t handle,
+                  uint8_t const* data,
+                  size_t len) {
+  auto& l{links[peer]};
+  telemetry.link_rx_bytes.fetch_add(len, std::memory_order_relaxed);
+  if (l.rx_failed) {
+    // Data of a raw link which was in flight when it got dropped
+    if (l.rx_decided && !l.rx_framed) hold(l, data, len);
+    return;
+  }
+
+  // Check whether the first bytes are a hello, the last one carries the
+  // peer's capabilities
+  if (!l.rx_decided) {
+    if (l.mode.load() != LinkMode::Raw)
+      while (len && l.rx_hello < sizeof(hello) &&
+             (l.rx_hello < sizeof(hello) - 1u
+                ? *data == hello[l.rx_hello]
+                : (*data & link_caps_required) == link_caps_required)) {
+        if (l.rx_hello == sizeof(hello) - 1u) l.rx_caps = *data;
+        ++l.rx_hello;
+        ++data;
+        --len;
+      }
+
+    // Could still become a hello
+    if (!len && l.rx_hello < sizeof(hello) && l.mode.load() != LinkMode::Raw)
+      return;
+
+    l.rx_decided = true;
+    l.rx_framed = l.rx_hello == sizeof(hello) &&
+                  decide(l, LinkMode::Framed) == LinkMode::Framed;
+    if (!l.rx_framed) {
+      decide(l, LinkMode::Raw);
+      push_raw(l, peer, handle, hello, l.rx_hello);
+    }
+  }
+
+  if (l.rx_framed) deframe(peer, handle, data, len);
+  else push_raw(l, peer, handle, data, len);
+}
@@ -0,0 +1,220 @@
+/// Link
+///
+/// Sits between the channels and SPP. Bridges which both support it exchange a
+/// hello as the very first bytes of a connection and frame everything after
+/// that. Each frame carries a type and its length, so chunks which compress
+/// well get shipped compressed if both announce compression and all others
+/// untouched.
+///
+/// Older firmware must never see a hello, it would end up on its UART. The
+/// slave announces the capability in its SDP service name, only a master which
+/// found it sends a hello. The slave answers with its own hello and holds back
+/// data until it either got one or the first bytes from the master turned out
+/// to be regular data. If nothing arrives within bt_spp_hello_timeout the
+/// connection stays raw.
+///
+/// Bridges with several UART ports multiplex them if both announce it, the
+/// frame type then carries the port of a chunk. Otherwise only the first port
+/// gets bridged. Chunks of the priority lane get marked if both announce it,
+/// the peer then queues them ahead of the bulk data of other ports as long as
+/// none of their own port is queued.
+///
+/// Self-test frames carry the start of AT+TEST to the peer and its report back,
+/// bridges which both announce it qualify the link in both directions.
+///
+/// A hub keeps one link per peer, all link functions take the index of the
+/// peer.
+///
+/// Data frames carry a sequence number, a cumulative acknowledgement of the
+/// frames received from the peer and a CRC. Sent frames stay in a replay buffer
+/// until the peer acknowledged them. The stream outlives the connection, after
+/// a reconnect each side tells the other which frame it expects next and only
+/// the missing frames get sent again. If the peer lost track of the stream
+/// (e.g. it rebooted) or the frames it misses are gone, the stream restarts
+/// with a sync frame.
+///
+/// Received chunks which don't fit into their BT channel get dropped instead of
+/// waiting for room, the SPP callback never blocks. Once the channel has room
+/// again a rewind frame asks the peer to send everything from the dropped one
+/// on again. Peers which don't announce it get disconnected instead and resume
+/// after the reconnect. Raw links get disconnected as well, what didn't fit is
+/// held back until the connection reopened.
+///
+/// \file   link.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <esp_spp_api.h>
+#include <freertos/FreeRTOS.h>
+#include <cstddef>
+#include <cstdint>
+#include "config.hpp"
+
+/// Frame header size (type, length, sequence number, acknowledgement and
+/// session)
+constexpr size_t link_header_size{9u};
+
+/// Frame trailer size (CRC)
+constexpr size_t link_trailer_size{2u};
+
+/// Maximum frame size
+constexpr size_t link_max_frame_size{link_header_size + uart_chunk_size +
+                                     link_trailer_size};
+
+/// Reset connection state when a connection got opened
+///
+/// Data a raw link held back when its channel was full goes first.
+///
+/// \param  peer          Peer index
+/// \param  handle        BT connection handle
+/// \param  role          Own SPP role
+/// \param  peer_capable  Peer announced the capability (master only)
+void link_open(size_t peer,
+               uint32_t handle,
+               esp_spp_role_t role,
+               bool peer_capable);
+
+/// Wake up bt_tx_task waiting in a link function when a connection closed
+///
+/// \param  peer  Peer index
+void link_close(size_t peer);
+
+/// Hello which announces the capability
+///
+/// \param  len Length of hello
+/// \return Hello
+uint8_t const* link_hello(size_t& len);
+
+/// Check whether a hello must be sent before waiting for the peer's decision
+bool link_hello_first(size_t peer);
+
+/// Number of UART ports the link carries once it's decided, 1 unless both
+/// peers multiplex
+size_t link_ports(size_t peer);
+
+/// Wait until the link mode is decided (bt_tx_task)
+///
+/// \return true if the link is framed
+bool link_wait(size_t peer);
+
+/// Frame which tells the peer where to resume (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \param  len   Length of frame
+/// \return Frame
+uint8_t const* link_resume(size_t peer, size_t& len);
+
+/// Wait for the peer's resume frame and rewind to the frame it expects
+/// (bt_tx_task)
+///
+/// \return true if the peer's resume frame arrived
+bool link_wait_resume(size_t peer);
+
+/// Next frame to send again after resuming (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \param  len   Length of frame
+/// \return Frame or nullptr if there is nothing left to send again
+uint8_t const* link_retransmit(size_t peer, size_t& len);
+
+/// Check whether the replay buffer is full (bt_tx_task)
+///
+/// Bulk chunks leave the last slot to the priority lane.
+///
+/// \param  peer      Peer index
+/// \param  priority  Chunk of the priority lane
+bool link_replay_full(size_t peer, bool priority = false);
+
+/// Wait until the replay buffer has room, the peer asked to send again or the
+/// connection closed (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \param  ticks Ticks to wait
+void link_wait_replay(size_t peer, TickType_t ticks);
+
+/// Frame which asks the peer to send again what a full channel dropped
+/// (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \param  len   Length of frame
+/// \return Frame or nullptr if nothing got dropped or the channel is still
+///         full
+uint8_t const* link_rewind_request(size_t peer, size_t& len);
+
+/// Rewind to the oldest unacknowledged frame if the peer asked to send again
+/// (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \return true if frames are due for link_retransmit
+bool link_rewind(size_t peer);
+
+/// Frame a chunk and compress it if that makes it smaller (bt_tx_task)
+///
+/// The frame stays in the replay buffer until the peer acknowledged it, the
+/// replay buffer must not be full.
+///
+/// \param  peer  Peer index
+/// \param  port  UART port
+/// \param  data  Chunk
+/// \param  len   Length of chunk
+/// \param  frame_len Length of frame
+/// \param  priority  Chunk of the priority lane
+/// \return Frame
+uint8_t const* link_encode(size_t peer,
+                           size_t port,
+                           uint8_t const* data,
+                           size_t len,
+                           size_t& frame_len,
+                           bool priority = false);
+
+/// Frame which acknowledges received frames (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \param  len   Length of frame
+/// \return Frame or nullptr if all received frames got acknowledged already
+uint8_t const* link_ack(size_t peer, size_t& len);
+
+/// Ask the peer to run the self-test alongside if it announced it
+///
+/// The start goes ahead of the next chunk, after a reconnect ahead of the
+/// frames sent again. Whether the peer announced it gets checked right then,
+/// the link might still get negotiated. It gets sent again after every
+/// reconnect until the own self-test ran out.
+///
+/// \param  peer  Peer index
+/// \param  s     Duration [s]
+void link_selftest_start(size_t peer, uint32_t s);
+
+/// Send the report of the self-test the peer started back to it
+///
+/// It gets sent again after every reconnect until the peer starts another one.
+///
+/// \param  peer  Peer index
+void link_selftest_report(size_t peer);
+
+/// Self-test frame which is due (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \param  len   Length of frame
+/// \return Frame or nullptr if none is due
+uint8_t const* link_selftest(size_t peer, size_t& len);
+
+/// Check whether nothing is due on the link (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \return true if there is nothing to acknowledge, to ask the peer to send
+///         again, to send again or of the self-test to send
+bool link_settled(size_t peer);
+
+/// Handle received data (SPP callback)
+///
+/// \param  peer    Peer index
+/// \param  handle  BT connection handle
+/// \param  data    Data
+/// \param  len     Length of data
+void link_receive(size_t peer,
+                  uint32_t handle,
+                  uint8_t const* data,
+                  size_t len);
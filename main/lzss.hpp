@@ -0,0 +1,228 @@
+/// LZSS
+///
+/// Streaming LZSS with a small sliding window. The history is carried from
+/// one block to the next, so short blocks of similar data (log lines, sensor
+/// frames) compress well although every block can be decoded on its own once
+/// the blocks before it were seen. Blocks which the caller sends uncompressed
+/// must still be added to the history of both sides.
+///
+/// Every group of up to 8 items is preceded by a control byte, bit i set
+/// marks item i as match. A literal is a single byte, a match two bytes in
+/// little endian order with the distance - 1 in the upper 10 bits and the
+/// length - 3 in the lower 6 bits.
+///
+/// \file   lzss.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace lzss {
+
+/// Maximum distance of a match
+constexpr size_t max_window{1024u};
+
+/// Minimum and maximum length of a match
+constexpr size_t min_match{3u};
+constexpr size_t max_match{min_match + 63u};
+
+/// Compressor
+template<size_t Window, size_t MaxBlock>
+class Compressor {
+  static_assert(Window && Window <= max_window);
+
+public:
+  /// Compress a block
+  ///
+  /// The block always becomes part of the history, even if it doesn't fit.
+  ///
+  /// \param  src   Block
+  /// \param  len   Length of block
+  /// \param  dst   Destination
+  /// \param  max   Size of destination
+  /// \return Compressed length or 0 if it doesn't fit into max bytes
+  size_t operator()(uint8_t const* src, size_t len, uint8_t* dst, size_t max) {
+    if (len > MaxBlock) return 0u;
+    std::memcpy(&buf_[hist_], src, len);
+    auto const end{hist_ + len};
+
+    size_t o{}, ctrl{}, item{8u};
+    bool fits{true};
+    for (auto i{hist_}; i < end;) {
+      // Start a new group
+      if (item == 8u) {
+        if (o >= max) {
+          fits = false;
+          break;
+        }
+        ctrl = o++;
+        dst[ctrl] = 0u;
+        item = 0u;
+      }
+
+      auto const [dist, n]{find(i, end)};
+      if (n >= min_match) {
+        if (o + 2u > max) {
+          fits = false;
+          break;
+        }
+        auto const v{static_cast<uint16_t>(((dist - 1u) << 6u) |
+                                           (n - min_match))};
+        dst[o++] = static_cast<uint8_t>(v);
+        dst[o++] = static_cast<uint8_t>(v >> 8u);
+        dst[ctrl] |= static_cast<uint8_t>(1u << item);
+        for (auto j{i + 1u}; j < i + n && j + min_match <= end; ++j)
+          insert(j);
+        i += n;
+      } else {
+        if (o + 1u > max) {
+          fits = false;
+          break;
+        }
+        dst[o++] = buf_[i++];
+      }
+      ++item;
+    }
+
+    // Keep the tail as history
+    auto const keep{end < Window ? end : Window};
+    std::memmove(&buf_[0u], &buf_[end - keep], keep);
+    base_ += static_cast<uint32_t>(end - keep);
+    hist_ = keep;
+    return fits ? o : 0u;
+  }
+
+  /// Forget history
+  void reset() {
+    hist_ = 0u;
+    base_ = 0u;
+    table_.fill(0u);
+  }
+
+private:
+  static constexpr size_t hash_bits{9u};
+
+  struct Match {
+    size_t dist;
+    size_t len;
+  };
+
+  static uint32_t hash(uint8_t const* p) {
+    uint32_t const v{(uint32_t{p[0u]} << 16u) | (uint32_t{p[1u]} << 8u) |
+                     p[2u]};
+    return (v * 2654435761u) >> (32u - hash_bits);
+  }
+
+  /// Remember position i, returns the position previously stored
+  uint32_t insert(size_t i) {
+    auto& entry{table_[hash(&buf_[i])]};
+    auto const prev{entry};
+    entry = base_ + static_cast<uint32_t>(i) + 1u;
+    return prev;
+  }
+
+  /// Find the longest match at position i
+  Match find(size_t i, size_t end) {
+    if (i + min_match > end) return {};
+    auto const cand{insert(i)};
+    auto const pos{base_ + static_cast<uint32_t>(i)};
+    if (!cand || cand - 1u < base_ || pos - (cand - 1u) > Window) return {};
+    auto const j{static_cast<size_t>(cand - 1u - base_)};
+    auto const limit{end - i < max_match ? end - i : max_match};
+    size_t n{};
+    while (n < limit && buf_[j + n] == buf_[i + n]) ++n;
+    return {i - j, n};
+  }
+
+  std::array<uint8_t, Window + MaxBlock> buf_{};
+  std::array<uint32_t, 1u << hash_bits> table_{};
+  size_t hist_{};
+  uint32_t base_{};  ///< Stream position of buf_[0]
+};
+
+/// Decompressor
+template<size_t Window, size_t MaxBlock>
+class Decompressor {
+  static_assert(Window && Window <= max_window);
+
+public:
+  /// Decompress a block
+  ///
+  /// \param  src   Compressed block
+  /// \param  len   Length of compressed block
+  /// \param  dst   Destination of at least MaxBlock bytes
+  /// \return Decompressed length or -1 if the block is corrupt
+  int operator()(uint8_t const* src, size_t len, uint8_t* dst) {
+    auto const retval{decode(src, len, dst)};
+    if (retval >= 0) accept();
+    return retval;
+  }
+
+  /// Decompress a block without adding it to the history yet
+  ///
+  /// Until accept() got called the block can be decompressed again, e.g. once
+  /// its data found room.
+  ///
+  /// \param  src   Compressed block
+  /// \param  len   Length of compressed block
+  /// \param  dst   Destination of at least MaxBlock bytes
+  /// \return Decompressed length or -1 if the block is corrupt
+  int decode(uint8_t const* src, size_t len, uint8_t* dst) {
+    size_t o{hist_};
+    auto const end{hist_ + MaxBlock};
+    for (size_t i{}; i < len;) {
+      auto const ctrl{src[i++]};
+      for (auto item{0u}; item < 8u && i < len; ++item)
+        if (ctrl & (1u << item)) {
+          if (i + 2u > len) return -1;
+          auto const v{static_cast<uint16_t>(src[i] | (src[i + 1u] << 8u))};
+          i += 2u;
+          size_t const dist{(v >> 6u) + 1u};
+          size_t const n{(v & 0x3Fu) + min_match};
+          if (dist > o || o + n > end) return -1;
+          for (size_t j{}; j < n; ++j, ++o) buf_[o] = buf_[o - dist];
+        } else {
+          if (o >= end) return -1;
+          buf_[o++] = src[i++];
+        }
+    }
+    std::memcpy(dst, &buf_[hist_], o - hist_);
+    decoded_ = o;
+    return static_cast<int>(o - hist_);
+  }
+
+  /// Add the block decode() returned last to the history
+  void accept() { append(decoded_); }
+
+  /// Add a block which got sent uncompressed to the history
+  ///
+  /// \param  src   Block
+  /// \param  len   Length of block
+  void raw(uint8_t const* src, size_t len) {
+    if (len > MaxBlock) return;
+    std::memcpy(&buf_[hist_], src, len);
+    append(hist_ + len);
+  }
+
+  /// Forget history
+  void reset() { hist_ = decoded_ = 0u; }
+
+private:
+  /// Keep the tail as history
+  void append(size_t end) {
+    auto const keep{end < Window ? end : Window};
+    std::memmove(&buf_[0u], &buf_[end - keep], keep);
+    hist_ = keep;
+  }
+
+  std::array<uint8_t, Window + MaxBlock> buf_{};
+  size_t hist_{};
+  size_t decoded_{};  ///< End of the block decode() returned last
+};
+
+}  // namespace lzss
@@ -12,6 +12,7 @@
 #include <cstdint>
 #include <cstring>
 #include "config.hpp"
+#include "power.hpp"
 #include "uart.hpp"
 
 /// Application called from ESP-IDF
@@ -25,7 +26,12 @@ extern "C" void app_main() {
   }
   ESP_ERROR_CHECK(ret);
 
-  // Initialize BT and UART
-  bt_init();
+  // Initialize UART and start the tasks, they outlive every connection
   uart_init();
+  power_init();
+  uart_task_start_up();
+  bt_task_start_up();
+
+  // Initialize BT
+  bt_init();
 }
@@ -0,0 +1,78 @@
+/// Peer
+///
+/// \file   peer.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_log.h>
+#include <nvs.h>
+#include <cstring>
+#include "config.hpp"
+#include "peer.hpp"
+
+/// NVS key
+static constexpr auto key{"peer"};
+
+/// Layout in NVS, bump version whenever it changes
+struct Record {
+  uint8_t version;
+  uint8_t bda[ESP_BD_ADDR_LEN];
+  uint8_t scn;
+  uint8_t role;
+  uint8_t capable;
+};
+
+static constexpr uint8_t version{1u};
+
+bool peer_load(Peer& peer) {
+  nvs_handle_t handle;
+  if (nvs_open(nvs_namespace, NVS_READONLY, &handle) != ESP_OK) return false;
+  Record record{};
+  size_t len{sizeof(record)};
+  auto const ret{nvs_get_blob(handle, key, &record, &len)};
+  nvs_close(handle);
+  if (ret != ESP_OK || len != sizeof(record) || record.version != version)
+    return false;
+
+  std::memcpy(peer.bda, record.bda, sizeof(peer.bda));
+  peer.scn = record.scn;
+  peer.role = static_cast<esp_spp_role_t>(record.role);
+  peer.capable = record.capable;
+  return true;
+}
+
+void peer_store(Peer const& peer) {
+  // Spare the flash if nothing changed
+  Peer stored{};
+  if (peer_load(stored) &&
+      !std::memcmp(stored.bda, peer.bda, sizeof(peer.bda)) &&
+      stored.scn == peer.scn && stored.role == peer.role &&
+      stored.capable == peer.capable)
+    return;
+
+  nvs_handle_t handle;
+  esp_err_t ret{nvs_open(nvs_namespace, NVS_READWRITE, &handle)};
+  if (ret != ESP_OK) {
+    ESP_LOGE(bt_tag, "%s open failed: %s", __func__, esp_err_to_name(ret));
+    return;
+  }
+  Record record{.version = version,
+                .bda = {},
+                .scn = peer.scn,
+                .role = static_cast<uint8_t>(peer.role),
+                .capable = peer.capable};
+  std::memcpy(record.bda, peer.bda, sizeof(record.bda));
+  ret = nvs_set_blob(handle, key, &record, sizeof(record));
+  if (ret == ESP_OK) ret = nvs_commit(handle);
+  nvs_close(handle);
+  if (ret != ESP_OK)
+    ESP_LOGE(bt_tag, "%s write failed: %s", __func__, esp_err_to_name(ret));
+}
+
+void peer_forget() {
+  nvs_handle_t handle;
+  if (nvs_open(nvs_namespace, NVS_READWRITE, &handle) != ESP_OK) return;
+  nvs_erase_key(handle, key);
+  nvs_commit(handle);
+  nvs_close(handle);
+}
@@ -0,0 +1,37 @@
+/// Peer
+///
+/// The peer found by inquiry, its SPP server channel number and the role this
+/// device took get stored in NVS. The next boot connects the known peer right
+/// away instead of searching for it.
+///
+/// \file   peer.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <esp_bt_defs.h>
+#include <esp_spp_api.h>
+#include <cstdint>
+
+/// Peer
+struct Peer {
+  esp_bd_addr_t bda;
+  uint8_t scn;  ///< Server channel number of the peer, 0 if unknown
+  esp_spp_role_t role;
+  bool capable;  ///< Peer announced the link capability
+};
+
+/// Load peer from NVS
+///
+/// \param  peer  Peer
+/// \return true if a peer got stored before
+bool peer_load(Peer& peer);
+
+/// Store peer in NVS, unchanged peers don't get written again
+///
+/// \param  peer  Peer
+void peer_store(Peer const& peer);
+
+/// Remove peer from NVS
+void peer_forget();
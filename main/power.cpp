@@ -0,0 +1,140 @@
+/// Power
+///
+/// \file   power.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include "power.hpp"
+#include <driver/uart.h>
+#include <esp_gap_bt_api.h>
+#include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include "config.hpp"
+#include "telemetry.hpp"
+
+static_assert(power_active_poll >= ESP_BT_GAP_TPOLL_MIN &&
+              power_idle_poll <= ESP_BT_GAP_TPOLL_MAX);
+
+namespace {
+
+/// Link of a peer
+struct Link {
+  esp_bd_addr_t bda{};
+  std::atomic<bool> idle{};
+  std::atomic<int64_t> wake{};  ///< Switch to active got requested [us]
+};
+
+}  // namespace
+
+static std::array<Link, bt_max_peers> links;
+
+/// Time of the last traffic [us]
+static std::atomic<int64_t> last_activity{};
+
+/// Keeps the CPU out of light sleep while any link is active
+static esp_pm_lock_handle_t pm_lock{};
+static std::mutex pm_mutex;
+static bool pm_lock_held{};
+
+/// Hold the light sleep lock as long as any link is active (bt_tx_task)
+static void light_sleep_update() {
+  if constexpr (power_light_sleep) {
+    std::lock_guard lock{pm_mutex};
+    if (!pm_lock) return;
+    bool active{};
+    for (auto const& l : links) active |= !l.idle;
+    if (active && !pm_lock_held) esp_pm_lock_acquire(pm_lock);
+    else if (!active && pm_lock_held) esp_pm_lock_release(pm_lock);
+    pm_lock_held = active;
+  }
+}
+
+/// Ask the controller for a poll interval
+///
+/// \param  l       Link
+/// \param  t_poll  Poll interval [625us slots]
+static void set_poll(Link& l, uint32_t t_poll) {
+  if (auto const ret{esp_bt_gap_set_qos(l.bda, t_poll)}; ret != ESP_OK)
+    ESP_LOGW(bt_tag, "%s failed: %s", __func__, esp_err_to_name(ret));
+}
+
+void power_init() {
+  last_activity = esp_timer_get_time();
+  if constexpr (power_light_sleep) {
+    esp_pm_config_t const config{.max_freq_mhz = 240,
+                                 .min_freq_mhz = 80,
+                                 .light_sleep_enable = true};
+    if (auto const ret{esp_pm_configure(&config)}; ret != ESP_OK) {
+      ESP_LOGE(bt_tag, "%s light sleep: %s", __func__, esp_err_to_name(ret));
+      return;
+    }
+    esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "power", &pm_lock);
+    esp_pm_lock_acquire(pm_lock);
+    pm_lock_held = true;
+
+    // Only UART0 and UART1 wake the CPU up
+    auto const num{uart_ports[0u].num};
+    uart_set_wakeup_threshold(num, power_light_sleep_wake_edges);
+    esp_sleep_enable_uart_wakeup(num);
+  }
+}
+
+void power_activity() {
+  last_activity.store(esp_timer_get_time(), std::memory_order_relaxed);
+}
+
+void power_open(size_t peer, esp_bd_addr_t const bda) {
+  auto& l{links[peer]};
+  std::memcpy(l.bda, bda, sizeof(l.bda));
+  l.idle = false;
+  l.wake = 0;
+  power_activity();
+  light_sleep_update();
+}
+
+bool power_update(size_t peer) {
+  auto& l{links[peer]};
+  auto const now{esp_timer_get_time()};
+  bool const quiet{now - last_activity.load(std::memory_order_relaxed) >=
+                   int64_t{power_idle_timeout} * 1000};
+  if (quiet == l.idle) return quiet;
+  l.idle = quiet;
+
+  if (quiet) {
+    telemetry.power_idles.fetch_add(1u, std::memory_order_relaxed);
+    ESP_LOGI(bt_tag, "peer %u idle", static_cast<unsigned>(peer));
+    set_poll(l, power_idle_poll);
+  } else {
+    telemetry.power_wakes.fetch_add(1u, std::memory_order_relaxed);
+    l.wake = now;
+    set_poll(l, power_active_poll);
+  }
+  light_sleep_update();
+  return quiet;
+}
+
+bool power_idle() {
+  for (auto const& l : links)
+    if (!l.idle) return false;
+  return true;
+}
+
+void power_qos_done(esp_bd_addr_t const bda, uint32_t t_poll) {
+  for (auto& l : links) {
+    if (std::memcmp(l.bda, bda, sizeof(l.bda))) continue;
+    auto const wake{l.wake.exchange(0)};
+    if (wake && t_poll <= power_active_poll)
+      telemetry.power_wake_latency.add(
+        static_cast<uint32_t>(esp_timer_get_time() - wake));
+  }
+}
+
+void power_mode_changed(bool sniff) {
+  if (sniff) telemetry.power_sniffs.fetch_add(1u, std::memory_order_relaxed);
+}
@@ -0,0 +1,59 @@
+/// Power
+///
+/// Idle policy of the links. Traffic seen by uart_rx_task and the SPP callback
+/// keeps them active. Once there was none for power_idle_timeout the bt_tx_task
+/// of every peer asks the controller to poll its link every power_idle_poll
+/// slots instead of every power_active_poll, so the radio sleeps in between.
+/// Bluedroid's power manager is free to put the link into sniff mode on top,
+/// those transitions only get counted. If power_light_sleep is set the CPU
+/// may enter light sleep while every link is idle.
+///
+/// The first traffic after idle switches back right away. Until the
+/// controller confirmed the faster poll interval a frame waits for the next
+/// poll at most, power_wake_budget bounds the latency that adds. The time the
+/// switch took gets recorded as wake latency.
+///
+/// \file   power.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <esp_bt_defs.h>
+#include <cstddef>
+#include <cstdint>
+
+/// Initialize power management
+void power_init();
+
+/// Record traffic (uart_rx_task, SPP callback)
+void power_activity();
+
+/// Reset the link of a peer when a connection opened (SPP callback)
+///
+/// \param  peer  Peer index
+/// \param  bda   BT device address of the peer
+void power_open(size_t peer, esp_bd_addr_t const bda);
+
+/// Apply the idle policy to the link of a peer (bt_tx_task)
+///
+/// \param  peer  Peer index
+/// \return true if the link is idle
+bool power_update(size_t peer);
+
+/// Check whether every link is idle
+///
+/// Tasks may then wait for traffic without a timeout, so nothing keeps the CPU
+/// out of light sleep.
+bool power_idle();
+
+/// Called from GAP callback when the controller applied a poll interval
+///
+/// \param  bda     BT device address of the peer
+/// \param  t_poll  Poll interval [625us slots]
+void power_qos_done(esp_bd_addr_t const bda, uint32_t t_poll);
+
+/// Called from GAP callback when the power mode of a link changed
+///
+/// \param  sniff Link entered sniff mode
+void power_mode_changed(bool sniff);
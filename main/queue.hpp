@@ -6,11 +6,33 @@
 
 #pragma once
 
-#include <freertos/queue.h>
-#include <freertos/ringbuf.h>
+#include <array>
+#include <cstdint>
+#include "channel.hpp"
+#include "config.hpp"
 
-/// BT queue
-extern QueueHandle_t bt_queue;
+/// BT channels (SPP to UART), one per UART port and shared by all peers
+using bt_channel_t = Channel<bt_spp_buf_len, bt_spp_chunk_size>;
+extern std::array<bt_channel_t, size(uart_ports)> bt_channels;
 
-/// UART queue
-extern QueueHandle_t uart_queue;
\ No newline at end of file
+/// UART channels (UART to SPP), one per peer and UART port
+using uart_channel_t = Channel<uart_buf_len, uart_chunk_size>;
+extern std::array<std::array<uart_channel_t, size(uart_ports)>, bt_max_peers>
+  uart_channels;
+
+/// UART chunk
+using uart_chunk = uart_channel_t::Item;
+
+/// Priority lane channels, short chunks which overtake the bulk ones of other
+/// ports
+using priority_channel_t =
+  Channel<uart_priority_buf_len, uart_priority_chunk_size>;
+
+/// Priority lane channels (SPP to UART), one per UART port
+extern std::array<priority_channel_t, size(uart_ports)> bt_priority_channels;
+
+/// Priority lane channels (UART to SPP), one per UART port if any port picks
+/// chunks
+extern std::array<std::array<priority_channel_t, size(uart_ports)>,
+                  uart_priority_peers>
+  uart_priority_channels;
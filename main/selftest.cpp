@@ -0,0 +1,255 @@
+/// Self-test
+///
+/// \file   selftest.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_timer.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include "config.hpp"
+#include "selftest.hpp"
+#include "telemetry.hpp"
+
+/// Frame magic
+constexpr uint16_t selftest_magic{0xA55Au};
+
+/// Frame header size (magic and sequence number)
+constexpr size_t selftest_header_size{sizeof(uint16_t) + sizeof(uint32_t)};
+
+/// State of the peer's report
+enum class PeerState : uint8_t { None, Pending, Reported };
+
+static std::atomic<bool> active{};
+static std::atomic<bool> by_peer{};
+static std::atomic<PeerState> peer{};
+static std::atomic<uint32_t> generation{};
+static int64_t start_us{};
+static int64_t end_us{};
+static int64_t stop_us{};
+static SelftestReport peer_report{};
+static uint32_t start_retransmits{};
+static uint32_t start_rewinds{};
+
+static struct {
+  std::atomic<uint32_t> tx_frames;
+  std::atomic<uint32_t> rx_frames;
+  std::atomic<uint32_t> rx_bytes;
+  std::atomic<uint32_t> bit_errors;
+  std::atomic<uint32_t> byte_errors;
+  std::atomic<uint32_t> lost;
+  std::atomic<uint32_t> duplicated;
+  std::atomic<uint32_t> resyncs;
+} counters;
+
+/// Add to counter
+static void add(std::atomic<uint32_t>& counter, uint32_t value) {
+  counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+/// PRBS31 (x^31 + x^28 + 1) seeded by a sequence number
+///
+/// \param  seq Sequence number
+/// \return LFSR state, never 0
+static uint32_t prbs31_seed(uint32_t seq) {
+  return ((seq * 0x9E3779B1u) | 1u) & 0x7FFF'FFFFu;
+}
+
+/// Next 8 bits of PRBS31
+///
+/// \param  state LFSR state
+/// \return Next byte
+static uint8_t prbs31_next(uint32_t& state) {
+  uint8_t retval{};
+  for (auto i{0u}; i < 8u; ++i) {
+    uint32_t const bit{((state >> 30u) ^ (state >> 27u)) & 1u};
+    state = ((state << 1u) | bit) & 0x7FFF'FFFFu;
+    retval = static_cast<uint8_t>((retval << 1u) | bit);
+  }
+  return retval;
+}
+
+/// Check a complete frame
+///
+/// \param  frame     Frame
+/// \param  expected  Next expected sequence number, 0 if unknown
+static void check_frame(uint8_t const* frame, uint32_t& expected) {
+  uint32_t seq;
+  std::memcpy(&seq, frame + sizeof(uint16_t), sizeof(seq));
+  add(counters.rx_frames, 1u);
+
+  // Sequence numbers start at 1, so 0 means we're not synced yet
+  if (expected) {
+    if (seq > expected) add(counters.lost, seq - expected);
+    else if (seq < expected) add(counters.duplicated, 1u);
+  }
+  expected = seq + 1u;
+
+  uint32_t state{prbs31_seed(seq)};
+  uint32_t bit_errors{}, byte_errors{};
+  for (auto i{selftest_header_size}; i < selftest_frame_size; ++i)
+    if (auto const diff{static_cast<uint8_t>(frame[i] ^ prbs31_next(state))}) {
+      bit_errors += static_cast<uint32_t>(__builtin_popcount(diff));
+      ++byte_errors;
+    }
+  add(counters.rx_bytes, selftest_frame_size - selftest_header_size);
+  add(counters.bit_errors, bit_errors);
+  add(counters.byte_errors, byte_errors);
+}
+
+void selftest_start(uint32_t s, bool started_by_peer) {
+  for (auto* counter : {&counters.tx_frames,
+                        &counters.rx_frames,
+                        &counters.rx_bytes,
+                        &counters.bit_errors,
+                        &counters.byte_errors,
+                        &counters.lost,
+                        &counters.duplicated,
+                        &counters.resyncs})
+    counter->store(0u, std::memory_order_relaxed);
+  start_retransmits = telemetry.link_retransmits.load();
+  start_rewinds = telemetry.link_rewinds.load();
+  start_us = esp_timer_get_time();
+  end_us = s ? start_us + int64_t{s} * 1'000'000 : 0;
+  by_peer.store(started_by_peer, std::memory_order_relaxed);
+  peer.store(PeerState::None, std::memory_order_relaxed);
+  generation.fetch_add(1u, std::memory_order_release);
+  active.store(true, std::memory_order_release);
+}
+
+bool selftest_start_by_peer(uint32_t s) {
+  if (selftest_active()) {
+    selftest_expect_peer(false);
+    return false;
+  }
+  selftest_start(s, true);
+  return true;
+}
+
+bool selftest_by_peer() { return by_peer.load(std::memory_order_relaxed); }
+
+void selftest_expect_peer(bool expect) {
+  if (expect) return peer.store(PeerState::Pending);
+  auto pending{PeerState::Pending};
+  peer.compare_exchange_strong(pending, PeerState::None);
+}
+
+void selftest_peer_done(SelftestReport const& report) {
+  if (peer.load() != PeerState::Pending) return;
+  peer_report = report;
+  peer.store(PeerState::Reported, std::memory_order_release);
+}
+
+bool selftest_peer_pending() { return peer.load() == PeerState::Pending; }
+
+bool selftest_peer_report(SelftestReport& report) {
+  if (peer.load(std::memory_order_acquire) != PeerState::Reported)
+    return false;
+  report = peer_report;
+  return true;
+}
+
+void selftest_stop() {
+  stop_us = esp_timer_get_time();
+  active.store(false, std::memory_order_release);
+}
+
+bool selftest_active() { return active.load(std::memory_order_acquire); }
+
+bool selftest_due() {
+  return selftest_active() && end_us && esp_timer_get_time() >= end_us;
+}
+
+int selftest_generate(uint8_t* data, size_t max) {
+  static uint32_t seen{};
+  static uint32_t seq{};
+  if (auto const gen{generation.load(std::memory_order_acquire)};
+      gen != seen) {
+    seen = gen;
+    seq = 0u;
+  }
+
+  size_t len{};
+  for (; len + selftest_frame_size <= max; len += selftest_frame_size) {
+    auto const frame{data + len};
+    ++seq;
+    std::memcpy(frame, &selftest_magic, sizeof(selftest_magic));
+    std::memcpy(frame + sizeof(selftest_magic), &seq, sizeof(seq));
+    uint32_t state{prbs31_seed(seq)};
+    for (auto i{selftest_header_size}; i < selftest_frame_size; ++i)
+      frame[i] = prbs31_next(state);
+  }
+  add(counters.tx_frames, static_cast<uint32_t>(len / selftest_frame_size));
+  return static_cast<int>(len);
+}
+
+void selftest_check(uint8_t const* data, size_t len) {
+  static uint32_t seen{};
+  static uint8_t frame[selftest_frame_size];
+  static size_t fill{};
+  static uint32_t expected{};
+  if (auto const gen{generation.load(std::memory_order_acquire)};
+      gen != seen) {
+    seen = gen;
+    fill = 0u;
+    expected = 0u;
+  }
+
+  while (len) {
+    auto const n{std::min(len, selftest_frame_size - fill)};
+    std::memcpy(frame + fill, data, n);
+    fill += n;
+    data += n;
+    len -= n;
+    if (fill < selftest_frame_size) break;
+
+    // Drop a byte at a time until a header shows up
+    if (std::memcmp(frame, &selftest_magic, sizeof(selftest_magic))) {
+      add(counters.resyncs, 1u);
+      std::memmove(frame, frame + 1, --fill);
+      continue;
+    }
+
+    check_frame(frame, expected);
+    fill = 0u;
+  }
+}
+
+SelftestReport selftest_report() {
+  return {(selftest_active() ? esp_timer_get_time() : stop_us) - start_us,
+          counters.tx_frames.load(std::memory_order_relaxed),
+          counters.rx_frames.load(std::memory_order_relaxed),
+          counters.rx_bytes.load(std::memory_order_relaxed),
+          counters.bit_errors.load(std::memory_order_relaxed),
+          counters.byte_errors.load(std::memory_order_relaxed),
+          counters.lost.load(std::memory_order_relaxed),
+          counters.duplicated.load(std::memory_order_relaxed),
+          counters.resyncs.load(std::memory_order_relaxed),
+          telemetry.link_retransmits.load() - start_retransmits,
+          telemetry.link_rewinds.load() - start_rewinds};
+}
+
+void selftest_print(SelftestReport const& report, char const* name) {
+  auto const s{static_cast<double>(report.elapsed_us) / 1e6};
+  auto const bits{static_cast<double>(report.rx_bytes) * 8.0};
+  std::printf("%-11s %.3f s\n", name, s);
+  std::printf("  tx        %lu frames\n",
+              static_cast<unsigned long>(report.tx_frames));
+  std::printf("  rx        %lu frames, %lu bytes, %.0f B/s\n",
+              static_cast<unsigned long>(report.rx_frames),
+              static_cast<unsigned long>(report.rx_bytes),
+              s > 0.0 ? report.rx_bytes / s : 0.0);
+  std::printf("  errors    %lu bits (BER %.3g), %lu bytes\n",
+              static_cast<unsigned long>(report.bit_errors),
+              bits > 0.0 ? report.bit_errors / bits : 0.0,
+              static_cast<unsigned long>(report.byte_errors));
+  std::printf("  frames    %lu lost, %lu duplicated, %lu resync bytes\n",
+              static_cast<unsigned long>(report.lost),
+              static_cast<unsigned long>(report.duplicated),
+              static_cast<unsigned long>(report.resyncs));
+  std::printf("  retries   %lu tx frames, %lu rx rewinds\n",
+              static_cast<unsigned long>(report.tx_retries),
+              static_cast<unsigned long>(report.rx_retries));
+}
@@ -0,0 +1,110 @@
+/// Self-test
+///
+/// While the self-test runs uart_rx_task feeds PRBS frames instead of UART data
+/// into the pipeline and uart_tx_task checks the frames it receives instead of
+/// writing them to the UART. Everything in between is the regular firmware, so
+/// running it on a pair of bridges qualifies the link in both directions.
+///
+/// A frame starts with a magic and a sequence number, the payload is a PRBS31
+/// sequence seeded by the sequence number. The checker reassembles frames from
+/// the byte stream, counts bit and byte errors in the payload as well as lost
+/// and duplicated frames. Retries of the link get reported per direction, they
+/// show how much the link had to repeat to keep the stream intact.
+///
+/// AT+TEST starts the peer's self-test over the link as well. Each side checks
+/// what the other one generated, the peer sends its report back once its
+/// self-test ran out. The report of the bridge which started it therefore
+/// covers both directions.
+///
+/// \file   selftest.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Self-test report
+struct SelftestReport {
+  int64_t elapsed_us;     ///< Time since start
+  uint32_t tx_frames;     ///< Frames generated
+  uint32_t rx_frames;     ///< Frames checked
+  uint32_t rx_bytes;      ///< Payload bytes checked
+  uint32_t bit_errors;    ///< Payload bits which differed
+  uint32_t byte_errors;   ///< Payload bytes which differed
+  uint32_t lost;          ///< Frames skipped by the sequence number
+  uint32_t duplicated;    ///< Frames whose sequence number went backwards
+  uint32_t resyncs;       ///< Bytes dropped looking for a frame header
+  uint32_t tx_retries;    ///< Frames the link sent to the peer again
+  uint32_t rx_retries;    ///< Rewinds which had the peer send frames again
+};
+
+/// Start self-test, counters get reset
+///
+/// \param  s       Duration [s], 0 runs until selftest_stop
+/// \param  by_peer Peer started it and waits for the report
+void selftest_start(uint32_t s = 0u, bool by_peer = false);
+
+/// Start the self-test the peer asked for (SPP callback)
+///
+/// Ignored while a self-test runs already. Both sides then run their own and
+/// the peer reports nothing.
+///
+/// \param  s Duration [s]
+/// \return true if it started
+bool selftest_start_by_peer(uint32_t s);
+
+/// Check if the peer started the self-test
+bool selftest_by_peer();
+
+/// Wait for the peer's report of the self-test it runs alongside
+///
+/// \param  expect  false if the peer won't run it after all
+void selftest_expect_peer(bool expect = true);
+
+/// Take the peer's report (SPP callback)
+///
+/// \param  report  Report of the peer
+void selftest_peer_done(SelftestReport const& report);
+
+/// Check if the peer's report is still due
+bool selftest_peer_pending();
+
+/// Get the peer's report
+///
+/// \param  report  Report of the peer
+/// \return true if the peer reported
+bool selftest_peer_report(SelftestReport& report);
+
+/// Stop self-test, the elapsed time of its report stops as well
+void selftest_stop();
+
+/// Check if self-test runs
+bool selftest_active();
+
+/// Check if a self-test with a duration ran out
+bool selftest_due();
+
+/// Generate PRBS frames (uart_rx_task)
+///
+/// \param  data  Destination
+/// \param  max   Maximum number of bytes
+/// \return Number of bytes generated
+int selftest_generate(uint8_t* data, size_t max);
+
+/// Check received data (uart_tx_task)
+///
+/// \param  data  Data
+/// \param  len   Length of data
+void selftest_check(uint8_t const* data, size_t len);
+
+/// Take a report
+SelftestReport selftest_report();
+
+/// Print a report
+///
+/// \param  report  Report
+/// \param  name    Name of the direction it covers
+void selftest_print(SelftestReport const& report,
+                    char const* name = "selftest");
@@ -0,0 +1,95 @@
+/// Settings
+///
+/// \file   settings.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include "settings.hpp"
+#include <esp_log.h>
+#include <nvs.h>
+
+Settings settings{.baud_rate = uart_config_default.baud_rate,
+                  .chunk_size = uart_chunk_size,
+                  .aggregation = uart_aggregation,
+                  .aggregation_window = uart_aggregation_window,
+                  .flow_control = uart_flow_control};
+
+/// NVS key
+static constexpr auto key{"settings"};
+
+namespace {
+
+/// Layout in NVS, bump version whenever it changes
+struct Record {
+  uint8_t version;
+  uint8_t aggregation;
+  uint8_t flow_control;
+  uint8_t reserved;
+  uint32_t baud_rate;
+  uint32_t chunk_size;
+  uint32_t aggregation_window;
+};
+
+}  // namespace
+
+static constexpr uint8_t version{1u};
+
+void settings_defaults() {
+  settings.baud_rate = uart_config_default.baud_rate;
+  settings.chunk_size = uart_chunk_size;
+  settings.aggregation = uart_aggregation;
+  settings.aggregation_window = uart_aggregation_window;
+  settings.flow_control = uart_flow_control;
+}
+
+bool settings_load() {
+  nvs_handle_t handle;
+  if (nvs_open(nvs_namespace, NVS_READONLY, &handle) != ESP_OK) return false;
+  Record record{};
+  size_t len{sizeof(record)};
+  auto const ret{nvs_get_blob(handle, key, &record, &len)};
+  nvs_close(handle);
+  if (ret != ESP_OK || len != sizeof(record) || record.version != version)
+    return false;
+
+  // Records of another build may not fit this one
+  if (!record.baud_rate || !record.chunk_size ||
+      record.chunk_size > uart_chunk_size || !record.aggregation_window ||
+      record.aggregation > static_cast<uint8_t>(Aggregation::Adaptive) ||
+      record.flow_control > static_cast<uint8_t>(FlowControl::Software) ||
+      (record.flow_control == static_cast<uint8_t>(FlowControl::Hardware) &&
+       !uart_hw_flow_control(uart_ports[0u])))
+    return false;
+
+  settings.baud_rate = record.baud_rate;
+  settings.chunk_size = record.chunk_size;
+  settings.aggregation = static_cast<Aggregation>(record.aggregation);
+  settings.aggregation_window = record.aggregation_window;
+  settings.flow_control = static_cast<FlowControl>(record.flow_control);
+  return true;
+}
+
+bool settings_store() {
+  nvs_handle_t handle;
+  esp_err_t ret{nvs_open(nvs_namespace, NVS_READWRITE, &handle)};
+  if (ret != ESP_OK) {
+    ESP_LOGE(uart_tag, "%s open failed: %s", __func__, esp_err_to_name(ret));
+    return false;
+  }
+  Record const record{
+    .version = version,
+    .aggregation = static_cast<uint8_t>(settings.aggregation.load()),
+    .flow_control = static_cast<uint8_t>(settings.flow_control.load()),
+    .reserved = 0u,
+    .baud_rate = settings.baud_rate,
+    .chunk_size = settings.chunk_size,
+    .aggregation_window = settings.aggregation_window};
+  ret = nvs_set_blob(handle, key, &record, sizeof(record));
+  if (ret == ESP_OK) ret = nvs_commit(handle);
+  nvs_close(handle);
+  if (ret != ESP_OK) {
+    ESP_LOGE(uart_tag, "%s write failed: %s", __func__, esp_err_to_name(ret));
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,39 @@
+/// Settings
+///
+/// Pipeline parameters which can be tuned at runtime through the command mode.
+/// They start out as the selected profile says, settings stored in NVS
+/// override them at boot. The tasks pick up changes with the next chunk.
+///
+/// \file   settings.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "config.hpp"
+
+/// Settings
+struct Settings {
+  std::atomic<uint32_t> baud_rate;           ///< Data port baud rate
+  std::atomic<uint32_t> chunk_size;          ///< Chunk fill limit [bytes]
+  std::atomic<Aggregation> aggregation;      ///< Aggregation policy
+  std::atomic<uint32_t> aggregation_window;  ///< Aggregation window [ms]
+  std::atomic<FlowControl> flow_control;     ///< Flow control mode
+};
+
+extern Settings settings;
+
+/// Reset settings to the profile defaults
+void settings_defaults();
+
+/// Load settings from NVS
+///
+/// \return true if settings got stored before
+bool settings_load();
+
+/// Store settings in NVS
+///
+/// \return true on success
+bool settings_store();
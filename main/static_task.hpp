@@ -0,0 +1,47 @@
+/// Static task
+///
+/// Stack and task control block live in static storage, so creating a task
+/// neither touches the heap nor fails. The stack size is a template parameter,
+/// the storage shows up in the module which owns the task and counts towards
+/// its DRAM budget.
+///
+/// \file   static_task.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <array>
+#include <cstdint>
+#include "config.hpp"
+
+template<uint32_t StackSize>
+class StaticTask {
+public:
+  /// Create the task as a placement says
+  ///
+  /// \param  fn        Task function
+  /// \param  name      Task name
+  /// \param  arg       Task parameter
+  /// \param  placement Placement
+  /// \return Task handle
+  TaskHandle_t create(TaskFunction_t fn,
+                      char const* name,
+                      void* arg,
+                      TaskPlacement const& placement) {
+    return xTaskCreateStaticPinnedToCore(fn,
+                                         name,
+                                         StackSize,
+                                         arg,
+                                         placement.priority,
+                                         data(stack_),
+                                         &tcb_,
+                                         placement.core);
+  }
+
+private:
+  std::array<StackType_t, StackSize> stack_;
+  StaticTask_t tcb_;
+};
@@ -0,0 +1,200 @@
+/// Telemetry
+///
+/// \file   telemetry.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstdio>
+#include "telemetry.hpp"
+
+Telemetry telemetry;
+static std::array<std::atomic<TaskHandle_t>, telemetry_max_tasks> tasks{};
+static std::atomic<size_t> task_count{};
+
+/// Copy telemetry of one direction
+///
+/// \param  dir Telemetry of one direction
+/// \return Snapshot of one direction
+static TelemetrySnapshot::Direction snapshot(TelemetryDirection const& dir) {
+  TelemetrySnapshot::Direction retval{};
+  retval.rx_bytes = dir.rx_bytes.load(std::memory_order_relaxed);
+  retval.tx_bytes = dir.tx_bytes.load(std::memory_order_relaxed);
+  retval.rx_stalls = dir.rx_stalls.load(std::memory_order_relaxed);
+  retval.tx_stalls = dir.tx_stalls.load(std::memory_order_relaxed);
+  for (size_t i{}; i < size(retval.size); ++i)
+    retval.size[i] = dir.size.buckets[i].load(std::memory_order_relaxed);
+  for (size_t i{}; i < size(retval.residency); ++i)
+    retval.residency[i] =
+      dir.residency.buckets[i].load(std::memory_order_relaxed);
+  return retval;
+}
+
+/// Print a histogram on a single line
+///
+/// Only buckets which counted something get printed as "upper bound:count".
+template<size_t N>
+static void print(char const* name, std::array<uint32_t, N> const& buckets) {
+  std::printf("  %-10s", name);
+  for (size_t i{}; i < N; ++i)
+    if (buckets[i]) {
+      auto const count{static_cast<unsigned long>(buckets[i])};
+      if (i == N - 1u) std::printf(" >=%lu:%lu", 1ul << (i - 1u), count);
+      else std::printf(" <%lu:%lu", 1ul << i, count);
+    }
+  std::printf("\n");
+}
+
+/// Print one direction
+static void print(char const* name,
+                  TelemetrySnapshot::Direction const& dir) {
+  std::printf("%s\n", name);
+  std::printf("  rx        %lu bytes, %lu stalls\n",
+              static_cast<unsigned long>(dir.rx_bytes),
+              static_cast<unsigned long>(dir.rx_stalls));
+  std::printf("  tx        %lu bytes, %lu stalls\n",
+              static_cast<unsigned long>(dir.tx_bytes),
+              static_cast<unsigned long>(dir.tx_stalls));
+  print("size", dir.size);
+  print("residency", dir.residency);
+}
+
+uint32_t telemetry_stamp() {
+  return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+void telemetry_residency(TelemetryDirection& dir, uint32_t stamp) {
+  dir.residency.add(telemetry_stamp() - stamp);
+}
+
+void telemetry_register_task(TaskHandle_t task) {
+  if (!task) return;
+  auto const i{task_count.fetch_add(1u, std::memory_order_relaxed)};
+  if (i < telemetry_max_tasks) tasks[i].store(task, std::memory_order_release);
+}
+
+TelemetrySnapshot telemetry_snapshot() {
+  TelemetrySnapshot retval{};
+  retval.uptime_us = esp_timer_get_time();
+  retval.uart_to_bt = snapshot(telemetry.uart_to_bt);
+  retval.bt_to_uart = snapshot(telemetry.bt_to_uart);
+  retval.spp_write_errors =
+    telemetry.spp_write_errors.load(std::memory_order_relaxed);
+  retval.spp_congestions =
+    telemetry.spp_congestions.load(std::memory_order_relaxed);
+  retval.uart_fifo_overflows =
+    telemetry.uart_fifo_overflows.load(std::memory_order_relaxed);
+  retval.uart_buffer_full =
+    telemetry.uart_buffer_full.load(std::memory_order_relaxed);
+  retval.uart_flow_stops =
+    telemetry.uart_flow_stops.load(std::memory_order_relaxed);
+  retval.baud_rate_changes =
+    telemetry.baud_rate_changes.load(std::memory_order_relaxed);
+  retval.hub_drops = telemetry.hub_drops.load(std::memory_order_relaxed);
+  retval.link_rx_bytes =
+    telemetry.link_rx_bytes.load(std::memory_order_relaxed);
+  retval.link_tx_bytes =
+    telemetry.link_tx_bytes.load(std::memory_order_relaxed);
+  retval.link_retransmits =
+    telemetry.link_retransmits.load(std::memory_order_relaxed);
+  retval.link_lost_frames =
+    telemetry.link_lost_frames.load(std::memory_order_relaxed);
+  retval.link_crc_errors =
+    telemetry.link_crc_errors.load(std::memory_order_relaxed);
+  retval.link_connections =
+    telemetry.link_connections.load(std::memory_order_relaxed);
+  retval.link_rewinds = telemetry.link_rewinds.load(std::memory_order_relaxed);
+  retval.link_rx_drops =
+    telemetry.link_rx_drops.load(std::memory_order_relaxed);
+  retval.link_throttles =
+    telemetry.link_throttles.load(std::memory_order_relaxed);
+  retval.priority_chunks =
+    telemetry.priority_chunks.load(std::memory_order_relaxed);
+  retval.power_idles = telemetry.power_idles.load(std::memory_order_relaxed);
+  retval.power_wakes = telemetry.power_wakes.load(std::memory_order_relaxed);
+  retval.power_sniffs =
+    telemetry.power_sniffs.load(std::memory_order_relaxed);
+  for (size_t i{}; i < size(retval.power_wake_latency); ++i)
+    retval.power_wake_latency[i] =
+      telemetry.power_wake_latency.buckets[i].load(std::memory_order_relaxed);
+  for (size_t core{}; core < portNUM_PROCESSORS; ++core)
+    retval.idle_us[core] = static_cast<uint32_t>(ulTaskGetRunTimeCounter(
+      xTaskGetIdleTaskHandleForCore(static_cast<BaseType_t>(core))));
+  retval.free_heap = esp_get_free_heap_size();
+  retval.min_free_heap = esp_get_minimum_free_heap_size();
+  for (auto const& task : tasks)
+    if (auto const handle{task.load(std::memory_order_acquire)})
+      retval.tasks[retval.task_count++] = {
+        pcTaskGetName(handle),
+        static_cast<uint32_t>(uxTaskGetStackHighWaterMark(handle))};
+  return retval;
+}
+
+void telemetry_print(TelemetrySnapshot const& snapshot) {
+  std::printf("uptime      %lld us\n",
+              static_cast<long long>(snapshot.uptime_us));
+  print("uart_to_bt", snapshot.uart_to_bt);
+  print("bt_to_uart", snapshot.bt_to_uart);
+  std::printf("spp         %lu write errors, %lu congestions\n",
+              static_cast<unsigned long>(snapshot.spp_write_errors),
+              static_cast<unsigned long>(snapshot.spp_congestions));
+  std::printf("uart        %lu fifo overflows, %lu buffer full, "
+              "%lu flow stops, %lu baud rate changes, %lu hub drops\n",
+              static_cast<unsigned long>(snapshot.uart_fifo_overflows),
+              static_cast<unsigned long>(snapshot.uart_buffer_full),
+              static_cast<unsigned long>(snapshot.uart_flow_stops),
+              static_cast<unsigned long>(snapshot.baud_rate_changes),
+              static_cast<unsigned long>(snapshot.hub_drops));
+  std::printf("link        %lu bytes rx, %lu bytes tx, %lu retransmits, "
+              "%lu lost frames, %lu crc errors, %lu connections, "
+              "%lu rewinds, %lu rx drops, %lu throttles, %lu priority "
+              "chunks\n",
+              static_cast<unsigned long>(snapshot.link_rx_bytes),
+              static_cast<unsigned long>(snapshot.link_tx_bytes),
+              static_cast<unsigned long>(snapshot.link_retransmits),
+              static_cast<unsigned long>(snapshot.link_lost_frames),
+              static_cast<unsigned long>(snapshot.link_crc_errors),
+              static_cast<unsigned long>(snapshot.link_connections),
+              static_cast<unsigned long>(snapshot.link_rewinds),
+              static_cast<unsigned long>(snapshot.link_rx_drops),
+              static_cast<unsigned long>(snapshot.link_throttles),
+              static_cast<unsigned long>(snapshot.priority_chunks));
+  std::printf("power       %lu idles, %lu wakes, %lu sniffs, "
+              "%lu us wake budget\n",
+              static_cast<unsigned long>(snapshot.power_idles),
+              static_cast<unsigned long>(snapshot.power_wakes),
+              static_cast<unsigned long>(snapshot.power_sniffs),
+              static_cast<unsigned long>(power_wake_budget));
+  print("wake", snapshot.power_wake_latency);
+  std::printf("heap        %lu free, %lu min free\n",
+              static_cast<unsigned long>(snapshot.free_heap),
+              static_cast<unsigned long>(snapshot.min_free_heap));
+  for (size_t i{}; i < snapshot.task_count; ++i)
+    std::printf("stack       %s %lu min free\n",
+                snapshot.tasks[i].name,
+                static_cast<unsigned long>(
+                  snapshot.tasks[i].stack_high_water_mark));
+}
+
+uint32_t telemetry_load(TelemetrySnapshot const& from,
+                        TelemetrySnapshot const& to,
+                        size_t core) {
+  auto const elapsed{to.uptime_us - from.uptime_us};
+  if (elapsed <= 0) return 0u;
+  int64_t const idle{to.idle_us[core] - from.idle_us[core]};
+  return static_cast<uint32_t>(
+    100 - std::min<int64_t>(idle * 100 / elapsed, 100));
+}
+
+void telemetry_print_load(TelemetrySnapshot const& from,
+                          TelemetrySnapshot const& to) {
+  std::printf("cpu        ");
+  for (size_t core{}; core < portNUM_PROCESSORS; ++core)
+    std::printf("%s core %u %lu%% load",
+                core ? "," : "",
+                static_cast<unsigned>(core),
+                static_cast<unsigned long>(telemetry_load(from, to, core)));
+  std::printf("\n");
+}
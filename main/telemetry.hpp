@@ -0,0 +1,159 @@
+/// Telemetry
+///
+/// Counters and histograms are updated by the tasks with relaxed atomics and
+/// never reset. They are 32 bit wide and wrap, rates are derived from the
+/// difference of two snapshots.
+///
+/// \file   telemetry.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "config.hpp"
+
+/// Logarithmic histogram
+///
+/// Bucket 0 counts zeros, bucket i values in [2^(i-1), 2^i). The last bucket
+/// also takes everything above.
+template<size_t N>
+struct Histogram {
+  void add(uint32_t value) {
+    size_t const i{value ? 32u - static_cast<size_t>(__builtin_clz(value))
+                         : 0u};
+    buckets[i < N ? i : N - 1u].fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint32_t>, N> buckets{};
+};
+
+/// Histogram buckets of chunk sizes (up to 1024 and above)
+constexpr size_t telemetry_size_buckets{12u};
+
+/// Histogram buckets of channel residency in us (up to 0.5s and above)
+constexpr size_t telemetry_residency_buckets{20u};
+
+/// Maximum number of tasks whose stack gets watched (UART tasks of every port
+/// and BT transmit task of every peer)
+constexpr size_t telemetry_max_tasks{2u * size(uart_ports) + bt_max_peers};
+
+/// Telemetry of one direction of the pipeline
+struct TelemetryDirection {
+  std::atomic<uint32_t> rx_bytes{};   ///< Bytes taken from the source
+  std::atomic<uint32_t> tx_bytes{};   ///< Bytes handed to the sink
+  std::atomic<uint32_t> rx_stalls{};  ///< Source found the channel full
+  std::atomic<uint32_t> tx_stalls{};  ///< Sink didn't take data right away
+  Histogram<telemetry_size_buckets> size;            ///< Item sizes
+  Histogram<telemetry_residency_buckets> residency;  ///< Time in channel [us]
+};
+
+/// Telemetry
+struct Telemetry {
+  TelemetryDirection uart_to_bt;
+  TelemetryDirection bt_to_uart;
+  std::atomic<uint32_t> spp_write_errors{};  ///< Rejected esp_spp_write calls
+  std::atomic<uint32_t> spp_congestions{};   ///< Link became congested
+  std::atomic<uint32_t> uart_fifo_overflows{};  ///< Data got lost
+  std::atomic<uint32_t> uart_buffer_full{};     ///< Driver buffer exhausted
+  std::atomic<uint32_t> uart_flow_stops{};      ///< Backpressure towards host
+  std::atomic<uint32_t> baud_rate_changes{};    ///< Committed baud rates
+  std::atomic<uint32_t> hub_drops{};            ///< Bytes a full peer missed
+  std::atomic<uint32_t> link_rx_bytes{};        ///< Bytes received over air
+  std::atomic<uint32_t> link_tx_bytes{};        ///< Bytes sent over air
+  std::atomic<uint32_t> link_retransmits{};     ///< Frames sent again
+  std::atomic<uint32_t> link_lost_frames{};     ///< Frames peer never got
+  std::atomic<uint32_t> link_crc_errors{};      ///< Frames received corrupt
+  std::atomic<uint32_t> link_connections{};     ///< Connections opened
+  std::atomic<uint32_t> link_rewinds{};         ///< Chunks a full channel lost
+  std::atomic<uint32_t> link_rx_drops{};        ///< Bytes a raw link lost
+  std::atomic<uint32_t> link_throttles{};       ///< Raw link dropped when full
+  std::atomic<uint32_t> priority_chunks{};      ///< Chunks on priority lane
+  std::atomic<uint32_t> power_idles{};          ///< Links switched to idle
+  std::atomic<uint32_t> power_wakes{};          ///< Links switched to active
+  std::atomic<uint32_t> power_sniffs{};         ///< Links entered sniff mode
+  Histogram<telemetry_residency_buckets> power_wake_latency;  ///< [us]
+};
+
+extern Telemetry telemetry;
+
+/// Plain copy of telemetry
+struct TelemetrySnapshot {
+  struct Direction {
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t rx_stalls;
+    uint32_t tx_stalls;
+    std::array<uint32_t, telemetry_size_buckets> size;
+    std::array<uint32_t, telemetry_residency_buckets> residency;
+  };
+
+  struct Task {
+    char const* name;
+    uint32_t stack_high_water_mark;  ///< Minimum free stack ever [bytes]
+  };
+
+  int64_t uptime_us;
+  Direction uart_to_bt;
+  Direction bt_to_uart;
+  uint32_t spp_write_errors;
+  uint32_t spp_congestions;
+  uint32_t uart_fifo_overflows;
+  uint32_t uart_buffer_full;
+  uint32_t uart_flow_stops;
+  uint32_t baud_rate_changes;
+  uint32_t hub_drops;
+  uint32_t link_rx_bytes;
+  uint32_t link_tx_bytes;
+  uint32_t link_retransmits;
+  uint32_t link_lost_frames;
+  uint32_t link_crc_errors;
+  uint32_t link_connections;
+  uint32_t link_rewinds;
+  uint32_t link_rx_drops;
+  uint32_t link_throttles;
+  uint32_t priority_chunks;
+  uint32_t power_idles;
+  uint32_t power_wakes;
+  uint32_t power_sniffs;
+  std::array<uint32_t, telemetry_residency_buckets> power_wake_latency;
+  std::array<uint32_t, portNUM_PROCESSORS> idle_us;  ///< Idle task run time
+  uint32_t free_heap;
+  uint32_t min_free_heap;
+  size_t task_count;
+  std::array<Task, telemetry_max_tasks> tasks;
+};
+
+/// Current time as channel item stamp
+uint32_t telemetry_stamp();
+
+/// Add time since stamp to a residency histogram
+void telemetry_residency(TelemetryDirection& dir, uint32_t stamp);
+
+/// Watch stack of a task
+void telemetry_register_task(TaskHandle_t task);
+
+/// Take a snapshot
+TelemetrySnapshot telemetry_snapshot();
+
+/// Print a snapshot
+void telemetry_print(TelemetrySnapshot const& snapshot);
+
+/// Load of a core between two snapshots
+///
+/// \param  from  Earlier snapshot
+/// \param  to    Later snapshot
+/// \param  core  Core
+/// \return Time the core didn't idle [%]
+uint32_t telemetry_load(TelemetrySnapshot const& from,
+                        TelemetrySnapshot const& to,
+                        size_t core);
+
+/// Print the load of every core between two snapshots
+void telemetry_print_load(TelemetrySnapshot const& from,
+                          TelemetrySnapshot const& to);
@@ -8,150 +8,814 @@
 #include <esp_log.h>
 #include <esp_system.h>
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <soc/uart_struct.h>
 #include <spi_flash_mmap.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdint>
-#include <memory>
+#include <cstring>
+#include <mutex>
+#include "baud_rate.hpp"
+#include "command.hpp"
 #include "config.hpp"
+#include "power.hpp"
 #include "queue.hpp"
+#include "selftest.hpp"
+#include "settings.hpp"
+#include "static_task.hpp"
+#include "telemetry.hpp"
+#include "uart.hpp"
+#include "uart_dma.hpp"
 
-QueueHandle_t uart_queue{nullptr};
-static RingbufHandle_t uart_buf{nullptr};
-static uart_config_t uart_config{uart_config_default};
+std::array<std::array<uart_channel_t, size(uart_ports)>, bt_max_peers>
+  uart_channels;
+std::array<std::array<priority_channel_t, size(uart_ports)>,
+           uart_priority_peers>
+  uart_priority_channels;
 static DRAM_ATTR uart_dev_t* const UART[UART_NUM_MAX] = {
   &UART0, &UART1, &UART2};
 
+/// State of an UART port
+struct Port {
+  QueueHandle_t event_queue{nullptr};
+  BaudRateDetector detector{uart_config_default.baud_rate};
+  std::mutex flow_mutex;
+  std::atomic<FlowControl> flow_control{};  ///< Mode the port runs
+  bool flow_stopped{};
+
+  // Command mode (data port only)
+  CommandEscape escape;
+  StaticSemaphore_t tx_mutex_buffer;
+  SemaphoreHandle_t tx_mutex{};  ///< Held by whoever writes to the port
+
+  // Adaptive aggregation
+  bool fill{};
+  int64_t rate{};
+  int64_t last{};
+};
+static std::array<Port, size(uart_ports)> ports;
+
+/// Receive state of a hub's UART port
+struct HubRx {
+  uint8_t data[uart_chunk_size];  ///< Staging buffer
+  uint8_t header[hub_header_size];
+  size_t header_fill{};
+  size_t peer{};  ///< Peer index or hub_broadcast
+  size_t left{};  ///< Bytes of the block still to come
+};
+static std::array<HubRx, bt_hub ? size(uart_ports) : 0u> hub_rx;
+
+/// Task names, the data port keeps the names of a single port build
+static constexpr char const* rx_task_names[]{
+  "uart_rx_task", "uart_rx_task1", "uart_rx_task2"};
+static constexpr char const* tx_task_names[]{
+  "uart_tx_task", "uart_tx_task1", "uart_tx_task2"};
+static_assert(size(uart_ports) <= std::size(rx_task_names));
+
+/// Tasks of every port
+static std::array<StaticTask<task_placement.uart_rx.stack_size>,
+                  size(uart_ports)>
+  rx_tasks;
+static std::array<StaticTask<task_placement.uart_tx.stack_size>,
+                  size(uart_ports)>
+  tx_tasks;
+
+static_assert(sizeof(uart_channels) + sizeof(uart_priority_channels) +
+                  sizeof(ports) + sizeof(hub_rx) + sizeof(rx_tasks) +
+                  sizeof(tx_tasks) <=
+                uart_dram_budget,
+              "UART exceeds its DRAM budget");
+
+/// Check whether the self-test replaces the data of a port
+///
+/// \param  i Port index
+static bool selftest(size_t i) {
+  return !bt_hub && !i && selftest_active();
+}
+
+/// Aggregation window of the settings in ticks
+static TickType_t aggregation_window() {
+  return std::max<TickType_t>(
+    pdMS_TO_TICKS(settings.aggregation_window.load(std::memory_order_relaxed)),
+    1u);
+}
+
+/// Set the baud rate of a port
+///
+/// The RX FIFO full threshold follows, so a continuous stream waits no longer
+/// than uart_rx_full_time in the FIFO.
+///
+/// \param  i         Port index
+/// \param  baud_rate Baud rate
+static void uart_set_baud_rate(size_t i, uint32_t baud_rate) {
+  auto const num{uart_ports[i].num};
+  uart_set_baudrate(num, baud_rate);
+  if constexpr (uart_backend == UartBackend::Driver)
+    uart_set_rx_full_threshold(
+      num,
+      std::clamp(static_cast<int>(baud_rate / 10u * uart_rx_full_time / 1000u),
+                 1,
+                 uart_rx_full_thresh));
+}
+
 /// Baud rate detection
 ///
-/// \param  lowpulse  Minimum low-pulse width
-/// \param  highpulse Minimum high-pulse width
-/// \return Detected baud rate
-static int baud_rate_detection(uint32_t lowpulse, uint32_t highpulse) {
-  constexpr int supported_baud_rates[]{
-    300,     600,     1200,    2400,    4800,    9600,    14400,
-    19200,   38400,   57600,   115200,  128000,  153600,  230400,
-    256000,  460800,  500000,  921600,  1000000, 1500000, 2000000,
-    2500000, 3000000, 3500000, 4000000, 4500000, 5000000};
+/// Feeds the auto baud pulse counters to the detector and restarts the
+/// measurement afterwards, so a glitch only ever affects a single sample.
+///
+/// \param  i Port index
+static void baud_rate_detection(size_t i) {
+  auto const num{uart_ports[i].num};
+  auto& detector{ports[i].detector};
+
+  auto const committed{
+    detector(UART[num]->lowpulse.min_cnt, UART[num]->highpulse.min_cnt)};
+
+  // Reset pulse counters
+  UART[num]->auto_baud.en = 0;
+  UART[num]->auto_baud.en = 1;
+
+  if (!committed) return;
+  telemetry.baud_rate_changes.fetch_add(1u, std::memory_order_relaxed);
+  if (!i) settings.baud_rate = detector.baud_rate();
+  uart_set_baud_rate(i, static_cast<uint32_t>(detector.baud_rate()));
+  if constexpr (uart_backend == UartBackend::Dma)
+    uart_dma_set_baud_rate(i, detector.baud_rate());
+  ESP_LOGI(uart_tag, "%s %d %d", __func__, num, detector.baud_rate());
+}
+
+/// Assert or release backpressure towards the host
+///
+/// RTS gets deasserted or XOFF gets sent right away by the hardware, ahead of
+/// whatever waits in the TX FIFO.
+///
+/// \param  num   Peripheral number
+/// \param  mode  Flow control mode
+/// \param  stop  Assert backpressure
+static void
+uart_flow_control_set(uart_port_t num, FlowControl mode, bool stop) {
+  switch (mode) {
+    case FlowControl::None: break;
+    case FlowControl::Hardware: uart_set_rts(num, !stop); break;
+    case FlowControl::Software:
+      if (stop) UART[num]->flow_conf.send_xoff = 1;
+      else UART[num]->flow_conf.send_xon = 1;
+      break;
+  }
+}
+
+/// Switch the flow control mode of a port
+///
+/// Backpressure asserted in the old mode gets released first. RTS follows the
+/// channel, CTS and XON/XOFF from the host are handled by the hardware. Other
+/// modes leave RTS alone, the pin may not even be connected.
+///
+/// \param  i     Port index
+/// \param  mode  Flow control mode
+static void uart_flow_control_mode(size_t i, FlowControl mode) {
+  auto const num{uart_ports[i].num};
+  auto& port{ports[i]};
+  std::lock_guard lock{port.flow_mutex};
+  if (port.flow_stopped)
+    uart_flow_control_set(num, port.flow_control, port.flow_stopped = false);
+  uart_set_hw_flow_ctrl(
+    num,
+    mode == FlowControl::Hardware ? UART_HW_FLOWCTRL_CTS
+                                  : UART_HW_FLOWCTRL_DISABLE,
+    0u);
+  uart_set_sw_flow_ctrl(num,
+                        mode == FlowControl::Software,
+                        uart_sw_flow_xon_thresh,
+                        uart_sw_flow_xoff_thresh);
+  if (mode == FlowControl::Hardware) uart_set_rts(num, 1);
+  port.flow_control = mode;
+}
+
+/// Read whatever the UART driver buffered
+///
+/// If the driver buffer is empty this waits for the driver to signal new data.
+/// UART_DATA events are raised when the RX FIFO reaches uart_rx_full_thresh
+/// and when the line was idle for uart_rx_timeout character times, so the
+/// task wakes up exactly at the end of a burst. Events of data which got read
+/// without waiting are drained as well, a full event queue would drop the
+/// event a later wait depends on. The DMA backend hands out what its engine
+/// received instead. uart_rx_wake ends a wait without data.
+///
+/// \param  i     Port index
+/// \param  data  Destination
+/// \param  max   Maximum number of bytes to read
+/// \param  ticks Ticks to wait for an event
+/// \return Number of bytes read
+static int
+uart_read_available(size_t i, uint8_t* data, size_t max, TickType_t ticks) {
+  if constexpr (uart_backend == UartBackend::Dma)
+    return uart_dma_read(i, data, max, ticks);
+  auto const num{uart_ports[i].num};
+  size_t buffered{};
+  uart_get_buffered_data_len(num, &buffered);
+
+  // Handle driver events, wait for one only while the buffer is empty
+  for (uart_event_t event;
+       xQueueReceive(ports[i].event_queue, &event, buffered ? 0u : ticks);) {
+    switch (event.type) {
+      // Data arrived or the driver buffer is full and RX interrupts are off
+      // until we read
+      case UART_DATA: break;
+      case UART_BUFFER_FULL:
+        telemetry.uart_buffer_full.fetch_add(1u, std::memory_order_relaxed);
+        break;
+
+      // Hardware FIFO overflowed, the driver reset it and that data is lost
+      case UART_FIFO_OVF:
+        telemetry.uart_fifo_overflows.fetch_add(1u, std::memory_order_relaxed);
+        ESP_LOGW(uart_tag, "%s RX FIFO overflow", __func__);
+        break;
+
+      // uart_rx_wake
+      case UART_EVENT_MAX: return 0;
+
+      default: break;
+    }
+    uart_get_buffered_data_len(num, &buffered);
+  }
+  if (!buffered) return 0;
+
+  buffered = std::min(buffered, max);
+  return std::max(uart_read_bytes(num, data, buffered, 0), 0);
+}
+
+/// Ticks to wait for the first byte of a read
+///
+/// Once every link is idle a read waits for data without a timeout, so the CPU
+/// may sleep until the next traffic. Only an escape sequence waiting for its
+/// guard time still needs the read to time out.
+///
+/// \param  i     Port index
+/// \param  ticks Ticks to wait while a link is active
+static TickType_t first_byte_ticks(size_t i, TickType_t ticks) {
+  if (ports[i].escape.pending())
+    return std::min(ticks, pdMS_TO_TICKS(command_guard_time));
+  return power_idle() ? portMAX_DELAY : ticks;
+}
+
+/// Read from UART with the latency policy
+///
+/// Ships whatever the driver buffered as soon as it signals data. Nothing is
+/// collected, so the read waits for the driver without a timeout.
+///
+/// \param  i     Port index
+/// \param  data  Destination
+/// \return Number of bytes read
+static int uart_read_latency(size_t i, uint8_t* data) {
+  return uart_read_available(
+    i,
+    data,
+    settings.chunk_size.load(std::memory_order_relaxed),
+    first_byte_ticks(i, portMAX_DELAY));
+}
 
-  uint32_t const pulse{(lowpulse + highpulse) / 2};
-  uint32_t const baud_rate{80'000'000 / pulse};
+/// Read from UART with the throughput policy
+///
+/// Collects data until a chunk is full or the aggregation window since the
+/// first byte elapsed.
+///
+/// \param  i     Port index
+/// \param  data  Destination
+/// \return Number of bytes read
+static int uart_read_throughput(size_t i, uint8_t* data) {
+  auto const window{aggregation_window()};
+  int const max{
+    static_cast<int>(settings.chunk_size.load(std::memory_order_relaxed))};
+  auto len{
+    uart_read_available(i, data, max, first_byte_ticks(i, window))};
+  if (!len) return len;
 
-  uint32_t i{};
-  for (; i < sizeof(supported_baud_rates) / sizeof(int); ++i)
-    if (baud_rate <= supported_baud_rates[i]) break;
+  auto const start{xTaskGetTickCount()};
+  for (TickType_t elapsed{}; len < max && elapsed < window;
+       elapsed = xTaskGetTickCount() - start)
+    len += uart_read_available(i, data + len, max - len, window - elapsed);
+  return len;
+}
 
-  if (!i) return supported_baud_rates[i];
+/// Read from UART according to the aggregation policy
+///
+/// The adaptive policy keeps a moving average of the arrival rate and fills
+/// chunks while it's above uart_aggregation_fill_rate. Once it drops below
+/// uart_aggregation_idle_rate chunks are shipped on idle again.
+///
+/// \param  i     Port index
+/// \param  data  Destination
+/// \return Number of bytes read
+static int uart_read_chunk(size_t i, uint8_t* data) {
+  auto const aggregation{settings.aggregation.load(std::memory_order_relaxed)};
+  if (aggregation == Aggregation::Latency) return uart_read_latency(i, data);
+  else if (aggregation == Aggregation::Throughput)
+    return uart_read_throughput(i, data);
   else {
-    if (baud_rate - supported_baud_rates[i - 1] <
-        supported_baud_rates[i] - baud_rate)
-      return supported_baud_rates[i - 1];
-    else
-      return supported_baud_rates[i];
+    auto& port{ports[i]};
+    auto const len{port.fill ? uart_read_throughput(i, data)
+                             : uart_read_latency(i, data)};
+
+    // Exponential moving average of bytes per second
+    auto const now{esp_timer_get_time()};
+    auto const dt{std::max<int64_t>(now - port.last, 1)};
+    port.last = now;
+    port.rate += (std::max(len, 0) * 1'000'000ll / dt - port.rate) / 4;
+
+    if (!port.fill && port.rate > uart_aggregation_fill_rate) port.fill = true;
+    else if (port.fill && port.rate < uart_aggregation_idle_rate)
+      port.fill = false;
+
+    return len;
   }
 }
 
-/// UART receive task
+/// Write data to UART
+///
+/// \param  i     Port index
+/// \param  data  Data
+/// \param  len   Length of data
+static void uart_write(size_t i, uint8_t const* data, size_t len) {
+  if constexpr (uart_backend == UartBackend::Dma)
+    return uart_dma_write(i, data, len);
+  auto const num{uart_ports[i].num};
+  while (len) {
+    int written_len{uart_write_bytes(num, (const char*)data, len)};
+    if (written_len <= 0) continue;
+    data += written_len;
+    if ((len -= written_len)) {
+      telemetry.bt_to_uart.tx_stalls.fetch_add(1u, std::memory_order_relaxed);
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+  }
+}
+
+/// Apply changed settings to every port
 ///
-/// \param  pvParameter Parameters passed to task
-static void uart_rx_task([[maybe_unused]] void* pvParameter) {
-  std::unique_ptr<uint8_t[]> rx{new (std::nothrow) uint8_t[uart_chunk_size]};
+/// The baud rate only applies to the data port, whatever got written before
+/// still leaves at the old one.
+static void uart_apply_settings() {
+  for (size_t i{}; i < size(uart_ports); ++i) {
+    auto const num{uart_ports[i].num};
+    auto& port{ports[i]};
+    auto const baud_rate{settings.baud_rate.load()};
+    if (!i && static_cast<int>(baud_rate) != port.detector.baud_rate()) {
+      if constexpr (uart_backend == UartBackend::Dma) uart_dma_wait_tx_done(i);
+      else uart_wait_tx_done(num, pdMS_TO_TICKS(command_guard_time));
+      uart_set_baud_rate(i, baud_rate);
+      port.detector = BaudRateDetector{static_cast<int>(baud_rate)};
+      ESP_LOGI(uart_tag,
+               "%s %d %lu",
+               __func__,
+               num,
+               static_cast<unsigned long>(baud_rate));
+    }
+    if constexpr (uart_backend == UartBackend::Dma) {
+      uint32_t current{};
+      uart_get_baudrate(num, &current);
+      uart_dma_set_baud_rate(i, current);
+    }
+    if (auto const mode{settings.flow_control.load()};
+        mode != port.flow_control)
+      uart_flow_control_mode(i, mode);
+  }
+}
 
-  for (;;) {
+/// Watch reads of the data port for the command escape
+///
+/// \param  i     Port index
+/// \param  data  Data
+/// \param  len   Length of data
+/// \return true if command mode should be entered
+static bool command_escape(size_t i, uint8_t const* data, int len) {
+  return !i && !selftest(i) &&
+         ports[i].escape(
+           data, static_cast<size_t>(std::max(len, 0)), esp_timer_get_time());
+}
+
+/// Command mode of the data port
+///
+/// Holds the TX mutex of the port, uart_tx_task keeps data of the peer back
+/// until command mode ends with ATO or once no command arrived within
+/// command_timeout. Settings get applied after their reply got written, so OK
+/// to a new baud rate still arrives at the old one. A self-test AT+TEST
+/// started returns here with its report.
+///
+/// \param  i       Port index
+/// \param  report  Self-test ran out
+static void command_mode(size_t i, bool report = false) {
+  auto& port{ports[i]};
+  xSemaphoreTake(port.tx_mutex, portMAX_DELAY);
+  ESP_LOGI(uart_tag, "%s enter", __func__);
+
+  alignas(4) char reply[256u]{"OK\r\n"};
+  if (report) command_selftest_report(reply, sizeof(reply));
+  uart_write(i, reinterpret_cast<uint8_t const*>(reply), std::strlen(reply));
+
+  char line[command_line_max];
+  size_t fill{};
+  bool overflow{};
+  auto last{esp_timer_get_time()};
+  for (bool stay{true}; stay;) {
     esp_task_wdt_reset();
+    uint8_t data[command_line_max];
+    auto const len{
+      uart_read_available(i, data, sizeof(data), pdMS_TO_TICKS(100))};
+    auto const now{esp_timer_get_time()};
+    if (len <= 0) {
+      if (now - last >= int64_t{command_timeout} * 1000) break;
+      continue;
+    }
+    last = now;
+    port.escape(data, static_cast<size_t>(len), now);
 
-    // Read data from UART
-    auto len{
-      uart_read_bytes(uart_num, &rx[0], uart_chunk_size, pdMS_TO_TICKS(10))};
-    if (len <= 0) continue;
+    for (int j{}; j < len && stay; ++j) {
+      auto const c{static_cast<char>(data[j])};
+      if (c != '\r' && c != '\n') {
+        if (fill < sizeof(line) - 1u) line[fill++] = c;
+        else overflow = true;
+        continue;
+      }
 
-    // Baud rate detection
-    auto const baud_rate{baud_rate_detection(
-      UART[uart_num]->lowpulse.min_cnt, UART[uart_num]->highpulse.min_cnt)};
-    if (baud_rate != uart_config.baud_rate) {
-      uart_config.baud_rate = baud_rate;
-      uart_param_config(uart_num, &uart_config);
+      // Empty line or second half of CR LF
+      if (!fill && !overflow) continue;
+      line[fill] = '\0';
+      if (overflow) std::strcpy(reply, "ERROR\r\n");
+      else stay = command_execute(line, reply, sizeof(reply));
+      fill = 0u;
+      overflow = false;
+      uart_write(
+        i, reinterpret_cast<uint8_t const*>(reply), std::strlen(reply));
+      uart_apply_settings();
+    }
+  }
+
+  xSemaphoreGive(port.tx_mutex);
+  ESP_LOGI(uart_tag, "%s leave", __func__);
+}
+
+/// Let self-test frames still in flight arrive before the self-test stops
+///
+/// Waits until no frame arrived for 100 ms, at most command_guard_time.
+static void selftest_drain() {
+  auto frames{selftest_report().rx_frames};
+  for (uint32_t ms{}; ms < command_guard_time; ms += 100u) {
+    esp_task_wdt_reset();
+    vTaskDelay(pdMS_TO_TICKS(100));
+    auto const now{selftest_report().rx_frames};
+    if (now == frames) break;
+    frames = now;
+  }
+}
+
+/// Wait for the peer's report of the self-test it ran alongside
+///
+/// The peer's self-test started a little later, it runs out, drains and sends
+/// its report within 2 * command_guard_time. Its frames still get checked
+/// meanwhile, they'd end up on the UART otherwise.
+static void selftest_wait_peer() {
+  for (uint32_t ms{};
+       selftest_peer_pending() && ms < 2u * command_guard_time;
+       ms += 100u) {
+    esp_task_wdt_reset();
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+}
+
+/// Copy data of a block into the UART channel of a peer
+///
+/// Never waits, a peer whose channel is full misses the data instead of
+/// holding up the others.
+///
+/// \param  peer  Peer index
+/// \param  i     Port index
+/// \param  data  Data
+/// \param  len   Length of data
+static void
+hub_dispatch(size_t peer, size_t i, uint8_t const* data, size_t len) {
+  auto& channel{uart_channels[peer][i]};
+  for (size_t j{}; j < len; j += uart_chunk_size) {
+    auto const n{std::min<size_t>(len - j, uart_chunk_size)};
+    auto const chunk{channel.acquire(0)};
+    if (!chunk) {
+      telemetry.hub_drops.fetch_add(len - j, std::memory_order_relaxed);
+      return;
     }
+    chunk->len = n;
+    chunk->stamp = telemetry_stamp();
+    std::memcpy(chunk->data, data + j, n);
+    channel.commit();
+  }
+}
 
-    // Send data to ring buffer
-    while (!xRingbufferSend(uart_buf, &rx[0], len, pdMS_TO_TICKS(10)))
-      vTaskDelay(pdMS_TO_TICKS(10));
+/// Split what a hub's UART port received into blocks and hand them to the
+/// peers they address
+///
+/// Bytes which don't start a header get skipped until the next sync byte.
+///
+/// \param  i     Port index
+/// \param  data  Data
+/// \param  len   Length of data
+static void hub_deframe(size_t i, uint8_t const* data, size_t len) {
+  auto& h{hub_rx[i]};
+  while (len) {
+    // Header
+    if (!h.left) {
+      if (!h.header_fill && *data != hub_frame_sync) {
+        ++data;
+        --len;
+        continue;
+      }
+      h.header[h.header_fill++] = *data++;
+      --len;
+      if (h.header_fill < hub_header_size) continue;
+      h.header_fill = 0u;
+      h.peer = h.header[1u];
+      h.left = static_cast<size_t>(h.header[2u] | h.header[3u] << 8u);
+      continue;
+    }
 
-    // Send ring buffer handle to queue
-    while (!xQueueSend(uart_queue, &uart_buf, pdMS_TO_TICKS(10)))
-      vTaskDelay(pdMS_TO_TICKS(10));
+    // Payload
+    auto const n{std::min(len, h.left)};
+    if (h.peer == hub_broadcast)
+      for (size_t peer{}; peer < bt_max_peers; ++peer)
+        hub_dispatch(peer, i, data, n);
+    else if (h.peer < bt_max_peers) hub_dispatch(h.peer, i, data, n);
+    data += n;
+    len -= n;
+    h.left -= n;
   }
 }
 
-/// UART transmit task
+/// UART receive task of a hub
+///
+/// Data gets read into a staging buffer and copied into the UART channels of
+/// the peers it's addressed to.
 ///
-/// \param  pvParameter Parameters passed to task
-static void uart_tx_task([[maybe_unused]] void* pvParameter) {
+/// \param  i Port index
+static void hub_rx_task(size_t i) {
+  auto& h{hub_rx[i]};
   for (;;) {
     esp_task_wdt_reset();
 
-    // Receive ring buffer handle from queue
-    RingbufHandle_t uart_buf{nullptr};
-    if (!xQueueReceive(bt_queue, &uart_buf, portMAX_DELAY)) continue;
+    auto const len{uart_read_chunk(i, h.data)};
+    if (command_escape(i, h.data, len)) command_mode(i);
+    if (len <= 0) continue;
+    power_activity();
+    baud_rate_detection(i);
 
-    // Receive data from ring buffer
-    uint8_t* data{nullptr};
-    size_t len{};
-    while (
-      !(data = (uint8_t*)xRingbufferReceive(uart_buf, &len, pdMS_TO_TICKS(10))))
-      vTaskDelay(pdMS_TO_TICKS(10));
+    telemetry.uart_to_bt.rx_bytes.fetch_add(len, std::memory_order_relaxed);
+    telemetry.uart_to_bt.size.add(len);
+    hub_deframe(i, h.data, static_cast<size_t>(len));
+    uart_flow_control_update(i);
+  }
+}
+
+/// Hand a chunk to the priority lane if uart_ports picks it
+///
+/// Only while no bulk chunk of the port waits for bt_tx_task, a chunk which
+/// overtook one would reorder the stream of the port.
+///
+/// \param  i     Port index
+/// \param  data  Chunk
+/// \param  len   Length of chunk
+/// \return true if the lane took the chunk, false if it isn't picked, bulk
+///         data waits or the lane is full
+static bool priority_send(size_t i, uint8_t const* data, size_t len) {
+  if constexpr (!uart_priority_peers) return false;
+  else {
+    auto const& port{uart_ports[i]};
+    if (len > uart_priority_chunk_size ||
+        (len > port.priority_len && data[0u] != port.priority_lead) ||
+        uart_channels[0u][i].size())
+      return false;
+    auto const item{uart_priority_channels[0u][i].acquire(0)};
+    if (!item) return false;
+    item->len = static_cast<uint32_t>(len);
+    item->stamp = telemetry_stamp();
+    std::memcpy(item->data, data, len);
+    uart_priority_channels[0u][i].commit();
+    telemetry.priority_chunks.fetch_add(1u, std::memory_order_relaxed);
+    return true;
+  }
+}
+
+/// UART receive task
+///
+/// Chunks are acquired from the UART channel and filled by the UART driver in
+/// place, or from the DMA descriptors. While BT transmits one chunk the next
+/// one is already being read. While the self-test runs chunks of the data port
+/// get filled with PRBS frames instead. Once it ran out command mode returns
+/// with the report, or the report goes back to the peer which started it.
+/// Reads of the data port get watched for the command escape. Chunks picked for
+/// the priority lane get copied there and the chunk is read again.
+///
+/// \param  pvParameter Port index
+static void uart_rx_task(void* pvParameter) {
+  auto const i{reinterpret_cast<size_t>(pvParameter)};
+  if constexpr (bt_hub) return hub_rx_task(i);
+  auto& channel{uart_channels[0u][i]};
+  for (;;) {
+    esp_task_wdt_reset();
+
+    // Acquire chunk from channel
+    auto const chunk{channel.acquire(pdMS_TO_TICKS(10))};
+    if (!chunk) {
+      telemetry.uart_to_bt.rx_stalls.fetch_add(1u, std::memory_order_relaxed);
+      continue;
+    }
 
-    // Write data to UART
-    while (len) {
-      int written_len{uart_write_bytes(uart_num, (const char*)data, len)};
-      if (written_len <= 0) continue;
-      if ((len -= written_len)) vTaskDelay(pdMS_TO_TICKS(10));
+    // Read data from UART directly into chunk, or generate self-test frames
+    int len;
+    for (;;) {
+      if (selftest(i) && selftest_due()) {
+        if (!selftest_by_peer()) selftest_wait_peer();
+        selftest_drain();
+        selftest_stop();
+        if (selftest_by_peer()) command_selftest_reply();
+        else command_mode(i, true);
+      }
+      len = selftest(i) ? selftest_generate(chunk->data, uart_chunk_size)
+                        : uart_read_chunk(i, chunk->data);
+      if (command_escape(i, chunk->data, len)) command_mode(i);
+      if (len > 0) break;
+      esp_task_wdt_reset();
     }
+    chunk->len = len;
+    power_activity();
+
+    // Baud rate detection
+    if (!selftest(i)) baud_rate_detection(i);
 
-    // Return item from ring buffer
-    vRingbufferReturnItem(uart_buf, (void*)data);
+    // Hand chunk over to bt_tx_task
+    telemetry.uart_to_bt.rx_bytes.fetch_add(len, std::memory_order_relaxed);
+    telemetry.uart_to_bt.size.add(len);
+    if (!selftest(i) && priority_send(i, chunk->data, chunk->len)) continue;
+    chunk->stamp = telemetry_stamp();
+    channel.commit();
+    uart_flow_control_update(i);
   }
 }
 
-/// Configure parameters of an UART driver, communication pins and install the
-/// driver.
-void uart_init() {
-  uart_buf = xRingbufferCreate(uart_buf_size, RINGBUF_TYPE_NOSPLIT);
-  if (!uart_buf) {
-    ESP_LOGE(uart_tag, "%s can't create ring buffer for UART", __func__);
+/// Write a BT channel item to an UART port
+///
+/// \param  i     Port index
+/// \param  item  Item
+template<typename Item>
+static void uart_write_item(size_t i, Item const& item) {
+  telemetry_residency(telemetry.bt_to_uart, item.stamp);
+
+  // Check self-test frames instead of writing them
+  if (selftest(i)) {
+    selftest_check(item.data, item.len);
+    telemetry.bt_to_uart.tx_bytes.fetch_add(item.len,
+                                            std::memory_order_relaxed);
     return;
   }
 
-  uart_queue = xQueueCreate(8, sizeof(RingbufHandle_t));
-  if (!uart_queue) {
-    ESP_LOGE(uart_tag, "%s can't create queue for UART", __func__);
+  // Write data to UART unless the port is in command mode, wait for it to end
+  // without polling
+  auto const tx_mutex{ports[i].tx_mutex};
+  while (!xSemaphoreTake(tx_mutex, pdMS_TO_TICKS(command_wait_time)))
+    esp_task_wdt_reset();
+  auto len{item.len};
+  if constexpr (bt_hub) {
+    alignas(4) uint8_t const header[hub_header_size]{
+      hub_frame_sync,
+      static_cast<uint8_t>(item.tag),
+      static_cast<uint8_t>(item.len),
+      static_cast<uint8_t>(item.len >> 8u)};
+    uart_write(i, header, sizeof(header));
+    len += sizeof(header);
+  }
+  uart_write(i, item.data, item.len);
+  xSemaphoreGive(tx_mutex);
+  telemetry.bt_to_uart.tx_bytes.fetch_add(len, std::memory_order_relaxed);
+}
+
+/// UART transmit task
+///
+/// Items are written to the UART straight out of the BT channel, items of the
+/// priority lane first. A hub precedes every item by a header which tells the
+/// peer it came from. While the self-test runs items of the data port get
+/// checked instead.
+///
+/// \param  pvParameter Port index
+static void uart_tx_task(void* pvParameter) {
+  auto const i{reinterpret_cast<size_t>(pvParameter)};
+  auto& channel{bt_channels[i]};
+  auto& lane{bt_priority_channels[i]};
+  for (;;) {
+    esp_task_wdt_reset();
+
+    // Receive item from channels and release it once written
+    if (auto const item{lane.receive(0)}) {
+      uart_write_item(i, *item);
+      lane.release();
+      continue;
+    }
+    if (auto const item{channel.receive(0)}) {
+      uart_write_item(i, *item);
+      channel.release();
+      continue;
+    }
+
+    // Park until either channel got an item
+    if (!lane.arm() && !channel.arm()) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+/// End a read of uart_rx_task waiting for data
+///
+/// A self-test the peer started has to replace the UART data right away, even
+/// if the read waits without timeout.
+///
+/// \param  i Port index
+void uart_rx_wake(size_t i) {
+  if constexpr (uart_backend == UartBackend::Dma) uart_dma_wake(i);
+  else {
+    uart_event_t event{};
+    event.type = UART_EVENT_MAX;
+    xQueueSend(ports[i].event_queue, &event, 0u);
+  }
+}
+
+/// Update flow control according to the UART channel fill level
+///
+/// Backpressure gets asserted once the fill level reaches uart_flow_stop_level
+/// and released once it dropped to uart_flow_resume_level. A hub goes by the
+/// fullest channel of its peers. Called by the producer after a chunk got
+/// committed and by the consumer after a chunk got released.
+///
+/// \param  i Port index
+void uart_flow_control_update(size_t i) {
+  auto& port{ports[i]};
+  if (port.flow_control.load(std::memory_order_relaxed) == FlowControl::None)
     return;
+  std::lock_guard lock{port.flow_mutex};
+  size_t level{};
+  for (auto const& channels : uart_channels)
+    level =
+      std::max(level, channels[i].size() * 100u / channels[i].capacity());
+  if (!port.flow_stopped && level >= uart_flow_stop_level) {
+    telemetry.uart_flow_stops.fetch_add(1u, std::memory_order_relaxed);
+    uart_flow_control_set(
+      uart_ports[i].num, port.flow_control, port.flow_stopped = true);
   }
+  else if (port.flow_stopped && level <= uart_flow_resume_level)
+    uart_flow_control_set(
+      uart_ports[i].num, port.flow_control, port.flow_stopped = false);
+}
+
+/// Configure parameters of the UART drivers, communication pins and install
+/// the drivers or connect the DMA engines. Settings stored in NVS replace the
+/// profile defaults.
+void uart_init() {
+  if (settings_load()) ESP_LOGI(uart_tag, "%s stored settings", __func__);
+  for (size_t i{}; i < size(uart_ports); ++i) {
+    auto const& cfg{uart_ports[i]};
+    ports[i].tx_mutex = xSemaphoreCreateMutexStatic(&ports[i].tx_mutex_buffer);
+    auto config{uart_config_default};
+    if (!i) config.baud_rate = static_cast<int>(settings.baud_rate.load());
+    uart_param_config(cfg.num, &config);
+    ports[i].detector = BaudRateDetector{config.baud_rate};
 
-  uart_param_config(uart_num, &uart_config);
-  uart_set_pin(uart_num, uart_tx_pin, uart_rx_pin, uart_rts_pin, uart_cts_pin);
-  uart_driver_install(uart_num, uart_buf_size, uart_buf_size, 0, NULL, 0);
+    // Flow control can be switched at runtime, route its pins either way
+    uart_set_pin(cfg.num, cfg.tx_pin, cfg.rx_pin, cfg.rts_pin, cfg.cts_pin);
+    if constexpr (uart_backend == UartBackend::Dma) uart_dma_init(i);
+    else {
+      uart_driver_install(cfg.num,
+                          uart_buf_size,
+                          uart_buf_size,
+                          uart_event_queue_len,
+                          &ports[i].event_queue,
+                          0);
+      uart_set_baud_rate(i, static_cast<uint32_t>(config.baud_rate));
+      uart_set_rx_timeout(cfg.num, uart_rx_timeout);
+    }
+
+    uart_flow_control_mode(i, settings.flow_control);
 
-  // Enable baud rate detection
-  UART[0]->auto_baud.en = 1;
+    // Enable baud rate detection
+    UART[cfg.num]->auto_baud.en = 1;
+    ports[i].last = esp_timer_get_time();
+  }
 }
 
-/// Start UART receive and transmit tasks on application core
+/// Start UART receive and transmit tasks of every port as task_placement says
+///
+/// The tasks outlive connections, they get started once at boot.
 void uart_task_start_up() {
-  xTaskCreatePinnedToCore(&uart_rx_task,
-                          "uart_rx_task",
-                          2048,
-                          NULL,
-                          task_priority_uart_rx,
-                          NULL,
-                          APP_CPU_NUM);
-  xTaskCreatePinnedToCore(&uart_tx_task,
-                          "uart_tx_task",
-                          2048,
-                          NULL,
-                          task_priority_uart_tx,
-                          NULL,
-                          APP_CPU_NUM);
+  for (size_t i{}; i < size(uart_ports); ++i) {
+    auto const arg{reinterpret_cast<void*>(i)};
+    telemetry_register_task(rx_tasks[i].create(
+      &uart_rx_task, rx_task_names[i], arg, task_placement.uart_rx));
+    telemetry_register_task(tx_tasks[i].create(
+      &uart_tx_task, tx_task_names[i], arg, task_placement.uart_tx));
+  }
 }
\ No newline at end of file
@@ -6,5 +6,9 @@
 
 #pragma once
 
+#include <cstddef>
+
 void uart_init();
-void uart_task_start_up();
\ No newline at end of file
+void uart_task_start_up();
+void uart_flow_control_update(size_t i);
+void uart_rx_wake(size_t i);
\ No newline at end of file
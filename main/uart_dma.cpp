@@ -0,0 +1,305 @@
+/// UART DMA
+///
+/// \file   uart_dma.cpp
+/// \author agent
+/// \date   16/10/2026
+
+#include "uart_dma.hpp"
+#include <esp_attr.h>
+#include <esp_intr_alloc.h>
+#include <esp_log.h>
+#include <esp_private/periph_ctrl.h>
+#include <esp_task_wdt.h>
+#include <freertos/task.h>
+#include <soc/lldesc.h>
+#include <soc/periph_defs.h>
+#include <soc/uart_struct.h>
+#include <soc/uhci_reg.h>
+#include <soc/uhci_struct.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include "config.hpp"
+#include "settings.hpp"
+#include "telemetry.hpp"
+
+namespace {
+
+/// Largest word aligned length a descriptor takes
+constexpr size_t max_desc_len{4092u};
+
+/// Bits per character on the line (start, 8 data, stop)
+constexpr uint32_t bits_per_char{10u};
+
+/// Interrupts the engine raises
+constexpr uint32_t rx_intr{UHCI_IN_SUC_EOF_INT_ENA | UHCI_IN_DONE_INT_ENA |
+                           UHCI_IN_DSCR_ERR_INT_ENA};
+constexpr uint32_t tx_intr{UHCI_OUT_TOTAL_EOF_INT_ENA};
+
+/// Ports which use DMA
+constexpr size_t dma_ports{
+  uart_backend == UartBackend::Dma ? size(uart_ports) : 0u};
+
+/// UHCI engine of a port
+struct Engine {
+  std::array<lldesc_t, uart_dma_rx_descs> rx_descs;
+  lldesc_t tx_desc;
+  size_t next{};    ///< RX descriptor to read next
+  size_t offset{};  ///< Bytes of it already read
+  std::atomic<bool> stalled{};  ///< Engine ran into a descriptor RX owns
+  std::atomic<bool> sent{};     ///< TX descriptor got pushed into the FIFO
+  std::atomic<bool> woken{};    ///< uart_dma_wake ended the wait
+  TaskHandle_t rx_task{nullptr};
+  TaskHandle_t tx_task{nullptr};
+};
+
+DRAM_ATTR std::array<Engine, dma_ports> engines;
+DMA_ATTR std::array<std::array<uint8_t, uart_chunk_size>,
+                    dma_ports * uart_dma_rx_descs>
+  rx_bufs;
+static_assert(!dma_ports ||
+                sizeof(engines) + sizeof(rx_bufs) <= uart_dma_dram_budget,
+              "UART DMA exceeds its DRAM budget");
+
+DRAM_ATTR uhci_dev_t* const uhci_devs[]{&UHCI0, &UHCI1};
+DRAM_ATTR uart_dev_t* const uart_devs[UART_NUM_MAX]{&UART0, &UART1, &UART2};
+constexpr periph_module_t uhci_modules[]{PERIPH_UHCI0_MODULE,
+                                         PERIPH_UHCI1_MODULE};
+constexpr int uhci_intr_sources[]{ETS_UHCI0_INTR_SOURCE,
+                                  ETS_UHCI1_INTR_SOURCE};
+
+/// Descriptor address as the link registers take it
+uint32_t link_addr(lldesc_t const* desc) {
+  return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(desc) &
+                               UHCI_INLINK_ADDR_V);
+}
+
+/// Hand a RX descriptor back to the engine
+void give(lldesc_t& desc) {
+  desc.length = 0u;
+  desc.eof = 0u;
+  desc.owner = 1u;
+}
+
+/// Start the engine at a RX descriptor
+///
+/// \param  i     Port index
+/// \param  desc  Descriptor
+void start_rx(size_t i, lldesc_t const* desc) {
+  auto const dev{uhci_devs[i]};
+  dev->dma_in_link.addr = link_addr(desc);
+  dev->dma_in_link.start = 1u;
+}
+
+/// UHCI interrupt
+///
+/// Wakes up the task waiting for the engine, the tasks find out what happened
+/// from the descriptors.
+///
+/// \param  arg Port index
+void IRAM_ATTR isr(void* arg) {
+  auto const i{reinterpret_cast<size_t>(arg)};
+  auto& e{engines[i]};
+  auto const dev{uhci_devs[i]};
+  auto const status{dev->int_st.val};
+  dev->int_clr.val = status;
+
+  BaseType_t woken{pdFALSE};
+  if (status & UHCI_IN_DSCR_ERR_INT_ST)
+    e.stalled.store(true, std::memory_order_relaxed);
+  if ((status & rx_intr) && e.rx_task)
+    vTaskNotifyGiveFromISR(e.rx_task, &woken);
+  if (status & tx_intr) {
+    e.sent.store(true, std::memory_order_relaxed);
+    if (e.tx_task) vTaskNotifyGiveFromISR(e.tx_task, &woken);
+  }
+  portYIELD_FROM_ISR(woken);
+}
+
+}  // namespace
+
+/// Connect an UHCI engine to a port and start receiving
+///
+/// SLIP framing, escaping and CRC stay off, the engine passes the line through
+/// unchanged.
+///
+/// \param  i Port index
+void uart_dma_init(size_t i) {
+  if constexpr (dma_ports) {
+    auto const num{uart_ports[i].num};
+    auto& e{engines[i]};
+    auto const dev{uhci_devs[i]};
+
+    // Ring of RX descriptors
+    for (size_t j{}; j < uart_dma_rx_descs; ++j) {
+      auto& desc{e.rx_descs[j]};
+      std::memset(&desc, 0, sizeof(desc));
+      desc.size = uart_chunk_size;
+      desc.buf = data(rx_bufs[i * uart_dma_rx_descs + j]);
+      desc.qe.stqe_next = &e.rx_descs[(j + 1u) % uart_dma_rx_descs];
+      give(desc);
+    }
+
+    periph_module_enable(uhci_modules[i]);
+    dev->conf0.val = 0u;
+    dev->conf0.in_rst = 1u;
+    dev->conf0.in_rst = 0u;
+    dev->conf0.out_rst = 1u;
+    dev->conf0.out_rst = 0u;
+    dev->conf0.ahbm_fifo_rst = 1u;
+    dev->conf0.ahbm_fifo_rst = 0u;
+    dev->conf0.ahbm_rst = 1u;
+    dev->conf0.ahbm_rst = 0u;
+    dev->conf0.uart0_ce = num == UART_NUM_0;
+    dev->conf0.uart1_ce = num == UART_NUM_1;
+    dev->conf0.uart2_ce = num == UART_NUM_2;
+    dev->conf0.uart_idle_eof_en = 1u;
+    dev->conf0.len_eof_en = 1u;
+    dev->conf0.out_eof_mode = 1u;
+    dev->conf1.val = 0u;
+    dev->conf1.check_owner = 1u;
+    dev->escape_conf.val = 0u;
+
+    // End of frame once the line stayed idle for uart_rx_timeout characters
+    uart_devs[num]->idle_conf.rx_idle_thrhd = uart_rx_timeout * bits_per_char;
+    uint32_t baud_rate{};
+    uart_get_baudrate(num, &baud_rate);
+    uart_dma_set_baud_rate(i, baud_rate);
+
+    dev->int_clr.val = UINT32_MAX;
+    dev->int_ena.val = rx_intr | tx_intr;
+    if (esp_intr_alloc(uhci_intr_sources[i],
+                       ESP_INTR_FLAG_IRAM,
+                       &isr,
+                       reinterpret_cast<void*>(i),
+                       nullptr) != ESP_OK) {
+      ESP_LOGE(uart_tag, "%s interrupt allocation failed", __func__);
+      return;
+    }
+    start_rx(i, &e.rx_descs[0u]);
+  }
+}
+
+/// Cut frames to the length which suits a baud rate and the aggregation
+/// window of the settings
+///
+/// \param  i         Port index
+/// \param  baud_rate Baud rate
+void uart_dma_set_baud_rate(size_t i, uint32_t baud_rate) {
+  if constexpr (dma_ports)
+    uhci_devs[i]->pkt_thres.thrs =
+      uart_dma_frame_len(baud_rate, settings.aggregation_window);
+}
+
+/// Read what the engine received
+///
+/// Done descriptors get copied in order and handed back right away, a
+/// descriptor which doesn't fit is continued by the next call. If the engine
+/// stalled it gets restarted once the descriptor it stopped at is free again.
+///
+/// \param  i     Port index
+/// \param  data  Destination
+/// \param  max   Maximum number of bytes to read
+/// \param  ticks Ticks to wait for a descriptor
+/// \return Number of bytes read
+int uart_dma_read(size_t i, uint8_t* data, size_t max, TickType_t ticks) {
+  if constexpr (!dma_ports) return 0;
+  else {
+    auto& e{engines[i]};
+    e.rx_task = xTaskGetCurrentTaskHandle();
+
+    // Wait for the engine to hand back a descriptor
+    auto desc{&e.rx_descs[e.next]};
+    while (desc->owner)
+      if (!ulTaskNotifyTake(pdTRUE, ticks) || e.woken.exchange(false))
+        return 0;
+
+    size_t len{};
+    while (len < max && !desc->owner) {
+      // The engine is done with the descriptor, its buffer is ours until it
+      // gets handed back
+      auto const buf{const_cast<uint8_t const*>(desc->buf)};
+      auto const n{std::min<size_t>(desc->length - e.offset, max - len)};
+      std::memcpy(data + len, buf + e.offset, n);
+      len += n;
+      if ((e.offset += n) < desc->length) break;
+      e.offset = 0u;
+      give(*desc);
+      e.next = (e.next + 1u) % uart_dma_rx_descs;
+      desc = &e.rx_descs[e.next];
+    }
+
+    // Engine ran out of descriptors and the UART FIFO most likely overflowed
+    if (desc->owner && e.stalled.exchange(false, std::memory_order_relaxed)) {
+      telemetry.uart_fifo_overflows.fetch_add(1u, std::memory_order_relaxed);
+      ESP_LOGW(uart_tag, "%s RX DMA stalled", __func__);
+      start_rx(i, desc);
+    }
+
+    return static_cast<int>(len);
+  }
+}
+
+/// End a wait of uart_dma_read
+///
+/// \param  i Port index
+void uart_dma_wake(size_t i) {
+  if constexpr (dma_ports) {
+    auto& e{engines[i]};
+    e.woken = true;
+    if (e.rx_task) xTaskNotifyGive(e.rx_task);
+  }
+}
+
+/// Write data
+///
+/// Data longer than a descriptor takes gets pushed in pieces.
+///
+/// \param  i     Port index
+/// \param  data  Data
+/// \param  len   Length of data
+void uart_dma_write(size_t i, uint8_t const* data, size_t len) {
+  if constexpr (dma_ports) {
+    auto& e{engines[i]};
+    auto const dev{uhci_devs[i]};
+    e.tx_task = xTaskGetCurrentTaskHandle();
+    auto& desc{e.tx_desc};
+    while (len) {
+      auto const n{std::min(len, max_desc_len)};
+      std::memset(&desc, 0, sizeof(desc));
+      desc.size = (n + 3u) & ~size_t{3u};
+      desc.length = n;
+      desc.buf = data;
+      desc.eof = 1u;
+      desc.owner = 1u;
+
+      e.sent.store(false, std::memory_order_relaxed);
+      dev->dma_out_link.addr = link_addr(&desc);
+      dev->dma_out_link.start = 1u;
+      while (!e.sent.load(std::memory_order_relaxed))
+        if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10))) {
+          telemetry.bt_to_uart.tx_stalls.fetch_add(1u,
+                                                   std::memory_order_relaxed);
+          esp_task_wdt_reset();
+        }
+
+      data += n;
+      len -= n;
+    }
+  }
+}
+
+/// Wait until everything written left the UART
+///
+/// The engine is done once the data is in the TX FIFO, the FIFO drains at
+/// whatever baud rate the UART runs.
+///
+/// \param  i Port index
+void uart_dma_wait_tx_done(size_t i) {
+  if constexpr (dma_ports) {
+    auto const uart{uart_devs[uart_ports[i].num]};
+    while (uart->status.txfifo_cnt || uart->status.st_utx_out)
+      vTaskDelay(1u);
+  }
+}
@@ -0,0 +1,82 @@
+/// UART DMA
+///
+/// Drop-in for the UART driver calls when uart_backend is UartBackend::Dma.
+/// Every port gets an UHCI engine of its own which moves data between the UART
+/// FIFOs and memory.
+///
+/// RX runs through a ring of uart_dma_rx_descs descriptors, so the engine
+/// always has one to fill while uart_rx_task copies the previous ones into a
+/// chunk. A descriptor is handed back at the end of a frame, only then the
+/// engine interrupts. A frame ends once the line went idle for uart_rx_timeout
+/// characters, a stream which never goes idle gets cut into frames which take
+/// the aggregation window on the line. Running out of descriptors stalls the
+/// engine and the UART FIFO overflows, that shows up as uart_fifo_overflows.
+///
+/// TX points a single descriptor straight at the data to write, usually an
+/// item of the BT channel, and blocks until the engine pushed it into the FIFO.
+///
+/// \file   uart_dma.hpp
+/// \author agent
+/// \date   16/10/2026
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "config.hpp"
+
+/// Length after which a frame ends even if the line didn't go idle
+///
+/// \param  baud_rate  Baud rate
+/// \param  window     Aggregation window [ms]
+/// \return Frame length
+constexpr size_t uart_dma_frame_len(uint32_t baud_rate, uint32_t window) {
+  auto const len{baud_rate / 10u * window / 1000u};
+  return std::clamp<size_t>(len, 1u, uart_chunk_size);
+}
+
+/// Connect an UHCI engine to a port and start receiving
+///
+/// The UART must already be configured, the UART driver must not be installed.
+///
+/// \param  i Port index
+void uart_dma_init(size_t i);
+
+/// Cut frames to the length which suits a baud rate and the aggregation
+/// window of the settings
+///
+/// \param  i         Port index
+/// \param  baud_rate Baud rate
+void uart_dma_set_baud_rate(size_t i, uint32_t baud_rate);
+
+/// Read what the engine received (uart_rx_task)
+///
+/// If no descriptor is done yet this waits for the engine to hand one back.
+///
+/// \param  i     Port index
+/// \param  data  Destination
+/// \param  max   Maximum number of bytes to read
+/// \param  ticks Ticks to wait for a descriptor
+/// \return Number of bytes read
+int uart_dma_read(size_t i, uint8_t* data, size_t max, TickType_t ticks);
+
+/// End a wait of uart_dma_read, it returns without data
+///
+/// \param  i Port index
+void uart_dma_wake(size_t i);
+
+/// Write data (uart_tx_task)
+///
+/// The data must be word aligned and live in DMA capable memory.
+///
+/// \param  i     Port index
+/// \param  data  Data
+/// \param  len   Length of data
+void uart_dma_write(size_t i, uint8_t const* data, size_t len);
+
+/// Wait until everything written left the UART
+///
+/// \param  i Port index
+void uart_dma_wait_tx_done(size_t i);